@@ -0,0 +1,109 @@
+#include "Aligner.h"
+#include "BlastAligner.h"
+#include "PafAligner.h"
+#include "InternalAligner.h"
+
+// -----------------------------------------------------------------------------
+// Aligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+
+// ---- Aligner member functions -----------------------------------------------
+
+std::unique_ptr< Aligner > Aligner::create(
+  const std::string &name, const std::string &pafCmd,
+  const unsigned int minLen
+  )
+{
+  if ( name == "blast" ) return std::make_unique< BlastAligner >();
+  if ( name == "paf" ) return std::make_unique< PafAligner >( pafCmd );
+  if ( name == "internal" )
+    return std::make_unique< InternalAligner >( minLen );
+  return nullptr;
+}
+
+bool Aligner::buildIndex(
+  const Genome* genome, const std::string &idxPath, const std::string &tag
+  )
+{
+  // Contigs that are excluded completely are not indexed
+  std::vector< SeqRange > ranges;
+  for ( const auto &range : getGenomeRanges( genome, tag ) )
+    if ( !genome->getSearchedRegions( range.seqIdx ).empty() )
+      ranges.push_back( range );
+  return indexRanges( genome, ranges, idxPath );
+}
+
+std::vector< SeqRange > Aligner::getGenomeRanges(
+  const Genome* genome, const std::string &tag
+  )
+{
+  std::vector< SeqRange > ranges;
+  for ( unsigned int i = 0; i < genome->getNumContigs(); i++ )
+  {
+    std::string name = tag.empty() ? genome->getContigName( i ) :
+      tag + "_" + std::to_string( i );
+    ranges.push_back( { i, 0, genome->getSeqLen( i ), name } );
+  }
+  return ranges;
+}
+
+bool Aligner::isPipedInput( const Genome* genome )
+{
+  return genome->getFasta() == "-" || genome->isCompressed();
+}
+
+bool Aligner::runProgram(
+  const std::vector< std::string >            &args,
+  const Genome*                               input,
+  const std::vector< SeqRange >               &ranges,
+  const std::function< void( std::string& ) > &parseLine
+  )
+{
+  Process proc;
+  if ( !proc.start( args, input != nullptr ) )
+  {
+    std::cout << "Unable to start " << args[0] << "..." << std::endl;
+    exit( 1 );
+  }
+
+  // The sequences are written from another thread, so that the program
+  // does not block writing its output while it is reading its input
+  std::thread feeder;
+  if ( input != nullptr )
+  {
+    feeder = std::thread( [&proc, input, &ranges]()
+      {
+        FastaWriter writer( 80 );
+        writer.setSoftMask( true );
+        for ( const auto &range : ranges )
+        {
+          writer.addSeq( input, range.seqIdx, range.startPos, range.len,
+            range.name );
+        }
+        writer.write( proc.getStdin() );
+        proc.closeStdin();
+      } );
+  }
+
+  std::string line;
+  while ( proc.readLine( line ) ) parseLine( line );
+
+  if ( feeder.joinable() ) feeder.join();
+  return proc.wait() == 0;
+}
+
+std::string Aligner::getProgramOutput( const std::vector< std::string > &args )
+{
+  Process     proc;
+  std::string line;
+  std::string output;
+  if ( !proc.start( args ) ) return output;
+  if ( proc.readLine( line ) ) output = line;
+  while ( proc.readLine( line ) );
+  if ( proc.wait() != 0 ) output.clear();
+  return output;
+}
+
+// -----------------------------------------------------------------------------
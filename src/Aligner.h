@@ -0,0 +1,148 @@
+#include "Genome.h"
+#include "Process.h"
+#include "FastaWriter.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <iostream>
+
+// -----------------------------------------------------------------------------
+// Aligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+// This class is the interface to the aligners used to find the alignments
+// between genomes. An aligner builds an index of each subject genome,
+// optionally combines indexes so that a query is searched against several
+// subjects at once, and searches ranges of a query genome against an
+// index. The hits are decoded from the output of the aligner as they are
+// reported, so the rest of pearl does not depend on the output format of
+// any one aligner. Indexes are identified by a path prefix, so that they
+// can be kept in the cache between runs. Implementations must allow
+// indexes to be built and searched from several threads at once.
+// -----------------------------------------------------------------------------
+
+#ifndef _ALIGNER_
+#define _ALIGNER_
+
+// A range of a contig that is written to an aligner under a given name
+struct SeqRange
+{
+  unsigned int seqIdx;   // Index of the contig in the genome
+  size_t       startPos; // Position of the first residue in the contig
+  size_t       len;      // Number of residues
+  std::string  name;     // Name of the sequence given to the aligner
+};
+
+// A hit decoded from the output of an aligner. Positions are one based and
+// inclusive. Hits on the reverse strand of the subject have "sStart"
+// greater than "sEnd", as reported by blastn
+struct AlignRecord
+{
+  std::string qName;  // Name of the query sequence given to the aligner
+  std::string sName;  // Name of the subject sequence given to the aligner
+  uint32_t    qStart; // First position of the hit in the query
+  uint32_t    qEnd;   // Last position of the hit in the query
+  uint32_t    sStart; // First position of the hit in the subject
+  uint32_t    sEnd;   // Last position of the hit in the subject
+  uint32_t    length; // Length of the alignment
+  double      pIdent; // Percent identity of the alignment
+};
+
+class Aligner
+{
+public:
+
+  // Default ctor
+  Aligner()
+  { ; }
+
+  // Dtor
+  virtual ~Aligner()
+  { ; }
+
+  // Create the aligner with the input name: "blast", "paf" or "internal".
+  // "pafCmd" is the command used to run the external aligner of the "paf"
+  // backend, and "minLen" is the shortest alignment that is reported by
+  // the internal aligner. Returns null if the name is not an aligner
+  static std::unique_ptr< Aligner > create( const std::string &name,
+    const std::string &pafCmd, const unsigned int minLen );
+
+  // Return the name and version of the aligner, which identifies the
+  // indexes it builds. Empty if the version is not known
+  virtual std::string getVersion() = 0;
+
+  // Return the parameters of the searches, which identify their hits
+  virtual std::string getParams() const = 0;
+
+  // Returns true if indexes can be combined with "combineIndexes"
+  virtual bool canCombine() const = 0;
+
+  // Build an index of the genome at "idxPath". If "tag" is set the contigs
+  // are named by the tag and their index, rather than their names. Returns
+  // false if the index could not be built
+  bool buildIndex( const Genome* genome, const std::string &idxPath,
+    const std::string &tag );
+
+  // Build an index at "idxPath" of the ranges of the genome, each of which
+  // is a contig of the index under the name of the range. Returns false if
+  // the index could not be built
+  virtual bool indexRanges( const Genome* genome,
+    const std::vector< SeqRange > &ranges, const std::string &idxPath ) = 0;
+
+  // Combine the indexes at the input paths into an index at "outPath" that
+  // is searched as a single index. Returns false if the indexes can not be
+  // combined
+  virtual bool combineIndexes( const std::vector< std::string > &idxPaths,
+    const std::string &outPath ) = 0;
+
+  // Search the ranges of the query genome against the index. If "ranges" is
+  // null the whole genome is searched under the names of its contigs.
+  // "nSubjSeqs" is the number of contigs in the index, so that every hit
+  // can be reported. "onHit" is called from this thread for each hit in the
+  // order they are reported. Returns false if the search failed
+  virtual bool search( const Genome* query,
+    const std::vector< SeqRange >* ranges, const std::string &idxPath,
+    const uint32_t nSubjSeqs,
+    const std::function< void( AlignRecord& ) > &onHit ) = 0;
+
+  // Free any memory held for the index at "idxPath", which will not be
+  // searched again
+  virtual void releaseIndex( const std::string & /* idxPath */ )
+  { ; }
+
+  // Limit the memory held for the indexes to "maxMem" bytes, if the aligner
+  // holds its indexes in memory. Zero is no limit
+  virtual void setMemBudget( const size_t /* maxMem */ )
+  { ; }
+
+  // Return the ranges that cover each contig of the genome. If "tag" is set
+  // the contigs are named by the tag and their index
+  static std::vector< SeqRange > getGenomeRanges( const Genome* genome,
+    const std::string &tag = "" );
+
+protected:
+
+  // Returns true if the fasta file of the genome can not be read by an
+  // external program directly, because it is compressed or was read from
+  // stdin
+  static bool isPipedInput( const Genome* genome );
+
+  // Run an external program. If "input" is set the ranges of the genome are
+  // written to the standard input of the program as a fasta file. Each line
+  // of the output is passed to "parseLine". Exits if the program could not
+  // be started. Returns false if the program failed
+  static bool runProgram( const std::vector< std::string > &args,
+    const Genome* input, const std::vector< SeqRange > &ranges,
+    const std::function< void( std::string& ) > &parseLine );
+
+  // Return the first line of the output of a program, or an empty string
+  // if it could not be run
+  static std::string getProgramOutput(
+    const std::vector< std::string > &args );
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// -----------------------------------------------------------------------------
+// BinaryIO
+// Ryan D. Crawford
+// 2020/06/23
+// -----------------------------------------------------------------------------
+// Helpers for writing plain values to, and reading them back from, the
+// binary files written by pearl (genome caches, alignment caches and result
+// shards). Values are stored in the byte order of the host. Reads are bounds
+// checked against the end of the buffer.
+// -----------------------------------------------------------------------------
+
+#ifndef _BINARY_IO_
+#define _BINARY_IO_
+
+// Append a value to the end of a binary buffer
+template < typename T >
+inline void putValue( std::string &buf, const T &val )
+{
+  static_assert( std::is_trivially_copyable< T >::value, "plain types only" );
+  buf.append( reinterpret_cast< const char* >( &val ), sizeof( T ) );
+}
+
+// Append a string, preceded by its length
+inline void putString( std::string &buf, const std::string &str )
+{
+  putValue( buf, uint32_t( str.size() ) );
+  buf.append( str );
+}
+
+// Read a value and advance the position in the buffer. Returns false if
+// the buffer is too short.
+template < typename T >
+inline bool getValue( const char* &pos, const char* end, T &val )
+{
+  static_assert( std::is_trivially_copyable< T >::value, "plain types only" );
+  if ( end - pos < ptrdiff_t( sizeof( T ) ) ) return false;
+  memcpy( &val, pos, sizeof( T ) );
+  pos += sizeof( T );
+  return true;
+}
+
+// Read a string written by "putString" and advance the position
+inline bool getString( const char* &pos, const char* end, std::string &str )
+{
+  uint32_t len;
+  if ( !getValue( pos, end, len ) || end - pos < ptrdiff_t( len ) )
+    return false;
+  str.assign( pos, len );
+  pos += len;
+  return true;
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
@@ -1,4 +1,5 @@
 #include "BioSeq.h"
+#include "FastaWriter.h"
 using namespace std;
 
 // -----------------------------------------------------------------------------
@@ -8,118 +9,801 @@ using namespace std;
 // -----------------------------------------------------------------------------
 
 // This function reads in the fasta file. Returns true if the file
-// was able to be read in
+// was able to be read in. The file is memory mapped and the contig
+// boundaries are indexed in a single scan over the mapped pages.
 bool BioSeq::parseFasta( )
 {
-  std::string line;        // Current line in the fasta file
-  std::string *curContig;  // Pointer to the current contig
-  ifstream    ifs;         // File stream for the fasta file
-  int         seqIdx = -1; // Index of the contig being parsed
+  struct stat   sb;       // File status for the fasta file
+  unsigned char magic[2]; // First two bytes of the file
+
+  // Fasta files piped on stdin are streamed
+  if ( faPath == "-" ) return streamFasta( STDIN_FILENO );
 
-  // If the file stream has failed to open, return false
-  ifs.open( faPath.c_str() );
-  if ( ifs.fail() || !ifs.is_open() )
+  // If the file has failed to open, exit
+  int fd = open( faPath.c_str(), O_RDONLY );
+  if ( fd == -1 || fstat( fd, &sb ) == -1 )
   {
      std::cout << "Failed to open the fasta file..." << std::endl;
      exit(1);
   }
 
-  if ( ifs.peek() == std::ifstream::traits_type::eof() ) return false;
+  if ( sb.st_size == 0 )
+  {
+    close( fd );
+    return false;
+  }
 
-  // Read in the fasta file line by line
-  while ( getline( ifs, line ) )
+  // Compressed files are inflated as they are read
+  if ( pread( fd, magic, 2, 0 ) == 2 && magic[0] == 0x1f && magic[1] == 0x8b )
   {
+    bool isParsed = streamFasta( fd );
+    close( fd );
+    return isParsed;
+  }
 
-    if ( line[0] == '>')
-    {
-      seqIdx ++; // Advance the couter to the current contig
-      // Parse the line to get the name of the contig
-      seqNames.push_back( getSeqName( line ) );
+  // Map the file into memory. The mapping is read sequentially, once
+  void* data = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED )
+  {
+     std::cout << "Failed to map the fasta file..." << std::endl;
+     exit(1);
+  }
+  madvise( data, sb.st_size, MADV_SEQUENTIAL );
+
+  // Index the contigs and copy the residues into the sequence buffer. The
+  // buffer can not be larger than the file.
+  seqBuf.reserve( sb.st_size );
+  indexFasta( static_cast< const char* >( data ), sb.st_size );
+  munmap( data, sb.st_size );
+  checkSeqStats();
+  indexSeqNames();
 
-      // Create an empty contig to add sequences to
-      seqs.push_back( "" );
-      curContig = & seqs[ seqIdx ];
+  // Finished. Return true to indicate the the genome was parsed properly
+  return true;
+}
 
+// This function reads in the fasta file. Returns true if the file
+// was able to be read in
+bool BioSeq::parseFasta( std::vector< std::string > &faSeq )
+{
+  for ( auto &line : faSeq )
+  {
+    // Check if the first position of the string is a new header
+    if ( !line.empty() && line[0] == '>' )
+    {
+      // Parse the line to get the name of the contig and start a new contig
+      seqNames.push_back( getSeqName( line ) );
+      seqStarts.push_back( seqBuf.size() );
     } else {
 
       // Add the line to the current contig
-      *curContig += line;
+      appendSeq( line.data(), line.size() );
     }
   }
-  // Close up the output file stream
-  ifs.close();
 
   // Set the number of sequences included in the fasta file
-  maxSeqIdx = seqIdx;
-
-  // Convert the sequence to upper-case
-  convertToUper();
+  maxSeqIdx = seqNames.size() - 1;
+  indexSeqNames();
 
   // Finished. Return true to indicate the the genome was parsed properly
+  return !seqNames.empty();
+}
+
+void BioSeq::indexFasta( const char* data, const size_t size )
+{
+  const char* pos = data;        // Start of the current line
+  const char* end = data + size; // End of the buffer
+
+  while ( pos < end )
+  {
+    if ( *pos == '>' )
+    {
+      // Find the end of the header
+      const char* eol = static_cast< const char* >(
+        memchr( pos, '\n', end - pos )
+        );
+      if ( eol == NULL ) eol = end;
+
+      // Parse the line to get the name of the contig. The start of the new
+      // contig is the current end of the sequence buffer
+      std::string header( pos, eol - pos );
+      if ( !header.empty() && header.back() == '\r' ) header.pop_back();
+      seqNames.push_back( getSeqName( header ) );
+      seqStarts.push_back( seqBuf.size() );
+      pos = eol + 1;
+      continue;
+    }
+
+    // The sequence continues until the next line starting with a header
+    const char* next = pos;
+    do
+    {
+      next = static_cast< const char* >( memchr( next, '>', end - next ) );
+      if ( next == NULL ) next = end;
+      else if ( next[-1] != '\n' ) next++;
+      else break;
+    } while ( next < end );
+
+    // Add all of the lines to the current contig
+    if ( !seqNames.empty() ) appendSeq( pos, next - pos );
+    pos = next;
+  }
+
+  // Set the number of sequences included in the fasta file
+  maxSeqIdx = seqNames.size() - 1;
+}
+
+bool BioSeq::readCache( const std::string &cachePath )
+{
+  struct stat faSb;    // File status for the fasta file
+  struct stat cacheSb; // File status for the cache file
+  char        magic[8];
+  uint64_t    faSize;
+  int64_t     mtimeSec;
+  int64_t     mtimeNsec;
+  uint64_t    payloadHash;
+
+  if ( faPath == "-" || stat( faPath.c_str(), &faSb ) == -1 ) return false;
+
+  // Read the whole cache file with a single read
+  int fd = open( cachePath.c_str(), O_RDONLY );
+  if ( fd == -1 ) return false;
+  if ( fstat( fd, &cacheSb ) == -1 )
+  {
+    close( fd );
+    return false;
+  }
+  std::string buf( cacheSb.st_size, '\0' );
+  size_t nRead = 0;
+  while ( nRead < buf.size() )
+  {
+    ssize_t n = read( fd, &buf[ nRead ], buf.size() - nRead );
+    if ( n <= 0 ) break;
+    nRead += n;
+  }
+  close( fd );
+  if ( nRead < buf.size() ) return false;
+
+  // Check the header against the fasta file
+  const char* pos = buf.data();
+  const char* end = buf.data() + buf.size();
+  if ( !getValue( pos, end, magic ) || memcmp( magic, cacheMagic, 8 ) != 0 )
+    return false;
+  if ( !getValue( pos, end, faSize ) || !getValue( pos, end, mtimeSec ) ||
+    !getValue( pos, end, mtimeNsec ) || !getValue( pos, end, payloadHash ) )
+  {
+    return false;
+  }
+  if ( faSize != uint64_t( faSb.st_size ) ||
+    mtimeSec != int64_t( faSb.st_mtim.tv_sec ) ||
+    mtimeNsec != int64_t( faSb.st_mtim.tv_nsec ) )
+  {
+    return false;
+  }
+
+  // Check the contents against the hash
+  if ( hashBytes( pos, end - pos ) != payloadHash ) return false;
+
+  // Read the contents
+  std::string cachedPath;
+  uint64_t    nContigs;
+  uint8_t     isGzip;
+  if ( !getString( pos, end, cachedPath ) || cachedPath != faPath )
+    return false;
+  if ( !getValue( pos, end, nContigs ) ) return false;
+  seqNames.resize( nContigs );
+  seqStarts.resize( nContigs + 1 );
+  for ( auto &name : seqNames )
+    if ( !getString( pos, end, name ) ) return false;
+  for ( auto &start : seqStarts )
+  {
+    uint64_t val;
+    if ( !getValue( pos, end, val ) ) return false;
+    start = val;
+  }
+  if ( !getValue( pos, end, seqStats.nN ) ||
+    !getValue( pos, end, seqStats.nInvalid ) || !getValue( pos, end, isGzip ) )
+  {
+    return false;
+  }
+  compressed = isGzip;
+  if ( !seqBuf.deserialize( pos, end ) ) return false;
+
+  maxSeqIdx = seqNames.size() - 1;
+  indexSeqNames();
   return true;
 }
 
-// This function reads in the fasta file. Returns true if the file
-// was able to be read in
-bool BioSeq::parseFasta( std::vector< std::string > &faSeq )
+bool BioSeq::writeCache( const std::string &cachePath ) const
+{
+  struct stat faSb; // File status for the fasta file
+  if ( faPath == "-" || stat( faPath.c_str(), &faSb ) == -1 ) return false;
+
+  // Serialize the contents
+  std::string payload;
+  putString( payload, faPath );
+  putValue( payload, uint64_t( seqNames.size() ) );
+  for ( const auto &name : seqNames ) putString( payload, name );
+  for ( const auto &start : seqStarts ) putValue( payload, uint64_t( start ) );
+  putValue( payload, seqStats.nN );
+  putValue( payload, seqStats.nInvalid );
+  putValue( payload, uint8_t( compressed ) );
+  seqBuf.serialize( payload );
+
+  // The header identifies the version of the fasta file that was parsed
+  std::string header;
+  header.append( cacheMagic, 8 );
+  putValue( header, uint64_t( faSb.st_size ) );
+  putValue( header, int64_t( faSb.st_mtim.tv_sec ) );
+  putValue( header, int64_t( faSb.st_mtim.tv_nsec ) );
+  putValue( header, hashBytes( payload.data(), payload.size() ) );
+
+  // Write to a temporary file, then rename it so that other processes never
+  // read a partially written cache
+  std::string tmpPath = cachePath + ".tmp" + std::to_string( getpid() );
+  std::ofstream ofs( tmpPath.c_str(), std::ios::binary );
+  if ( ofs.fail() || !ofs.is_open() ) return false;
+  ofs.write( header.data(), header.size() );
+  ofs.write( payload.data(), payload.size() );
+  ofs.close();
+  if ( ofs.fail() || rename( tmpPath.c_str(), cachePath.c_str() ) != 0 )
+  {
+    remove( tmpPath.c_str() );
+    return false;
+  }
+  return true;
+}
+
+bool BioSeq::parseFai()
 {
-  std::string *curContig;           // Pointer to the current contig
-  ifstream    ifs;                  // File stream for the fasta file
-  auto        line = faSeq.begin(); // Iterator for the line in the fasta file
-  int         seqIdx = -1;          // Index of the contig being parsed
+  unsigned char magic[2]; // First two bytes of the file
+
+  // Compressed files and stdin can not be accessed randomly
+  if ( faPath == "-" ) return parseFasta();
+  int fd = open( faPath.c_str(), O_RDONLY );
+  if ( fd == -1 )
+  {
+     std::cout << "Failed to open the fasta file..." << std::endl;
+     exit(1);
+  }
+  bool isGzip = pread( fd, magic, 2, 0 ) == 2 && magic[0] == 0x1f &&
+    magic[1] == 0x8b;
+  close( fd );
+  if ( isGzip ) return parseFasta();
+
+  // Read the index, or create it if it is missing or out of date
+  std::string faiPath = faPath + ".fai";
+  if ( !readFai( faiPath ) && !buildFai( faiPath ) )
+  {
+    std::cout << "Irregular line lengths in " << faPath
+              << ", reading the whole file..." << std::endl;
+    return parseFasta();
+  }
 
-  // If the file stream has failed to open, return false
-  ifs.open( faPath.c_str() );
-  if ( ifs.fail() ) return false;
+  // Set the contig boundaries from the lengths in the index
+  seqStarts.assign( 1, 0 );
+  for ( const auto &entry : faiIdx )
+    seqStarts.push_back( seqStarts.back() + entry.len );
+  maxSeqIdx = seqNames.size() - 1;
+  lazy      = true;
+  openIdxFasta();
+  indexSeqNames();
+
+  return !seqNames.empty();
+}
 
-  // Read in the fasta file line by line
-  while ( line < faSeq.end() )
+bool BioSeq::readFai( const std::string &faiPath )
+{
+  struct stat faSb;  // File status for the fasta file
+  struct stat faiSb; // File status for the index
+
+  // The index must be at least as new as the fasta file
+  if ( stat( getIdxFasta().c_str(), &faSb ) == -1 ) return false;
+  if ( stat( faiPath.c_str(), &faiSb ) == -1 ) return false;
+  if ( faiSb.st_mtime < faSb.st_mtime ) return false;
+
+  std::ifstream ifs( faiPath.c_str() );
+  if ( ifs.fail() || !ifs.is_open() ) return false;
+  seqNames.clear();
+  faiIdx.clear();
+
+  // Each line has the name, length, offset, residues per line and bytes per
+  // line of a contig, separated by tabs
+  std::string line;
+  while ( getline( ifs, line ) )
   {
-    // Check if the first position of the string is a new header
-    if ( line->at( 0 ) == '>')
+    std::stringstream ss( line );
+    std::string       name;
+    FaiEntry          entry;
+    if ( !( ss >> name >> entry.len >> entry.offset >> entry.lineBases
+      >> entry.lineWidth ) )
     {
-      seqIdx ++; // Advance the couter to the current contig
+      seqNames.clear();
+      faiIdx.clear();
+      return false;
+    }
 
-      // Parse the line to get the name of the contig
-      seqNames.push_back( getSeqName( *line ) );
+    // An entry that could not have been written for this file would divide
+    // by zero, or read past the end of the file, so the index is rebuilt
+    if ( entry.len > 0 && ( entry.lineBases == 0 ||
+      entry.lineWidth <= entry.lineBases ||
+      getFaiOffset( entry, entry.len - 1 ) >= size_t( faSb.st_size ) ) )
+    {
+      seqNames.clear();
+      faiIdx.clear();
+      return false;
+    }
 
-      // Create an empty contig to add sequences to
-      seqs.push_back( "" );
-      curContig = & seqs[ seqIdx ];
-    } else {
+    // Process the name the same way as a fasta header
+    std::string header = ">" + name;
+    seqNames.push_back( getSeqName( header ) );
+    faiIdx.push_back( entry );
+  }
+  return !faiIdx.empty();
+}
 
-      // Add the line to the current contig
-      *curContig += *line;
+bool BioSeq::buildFai( const std::string &faiPath )
+{
+  struct stat sb; // File status for the fasta file
+
+  int fd = open( getIdxFasta().c_str(), O_RDONLY );
+  if ( fd == -1 || fstat( fd, &sb ) == -1 || sb.st_size == 0 )
+  {
+    if ( fd != -1 ) close( fd );
+    return false;
+  }
+  void* data = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( data == MAP_FAILED ) return false;
+  madvise( data, sb.st_size, MADV_SEQUENTIAL );
+
+  const char* start = static_cast< const char* >( data );
+  const char* end   = start + sb.st_size;
+  const char* pos   = start;
+  std::vector< std::string > faiNames; // Names as written in the index
+  bool isLastLine = false;             // True after a short line of residues
+  bool isRegular  = true;              // True if the line lengths are valid
+
+  seqNames.clear();
+  faiIdx.clear();
+  while ( pos < end && isRegular )
+  {
+    const char* eol = static_cast< const char* >(
+      memchr( pos, '\n', end - pos )
+      );
+    if ( eol == NULL ) eol = end;
+    size_t width = eol - pos + 1;
+    size_t bases = eol - pos;
+    if ( bases > 0 && pos[ bases - 1 ] == '\r' ) bases--;
+
+    if ( *pos == '>' )
+    {
+      // The name in the index is the header up to the first white space
+      std::string header( pos, bases );
+      faiNames.push_back(
+        header.substr( 1, header.find_first_of( " \t" ) - 1 )
+        );
+      seqNames.push_back( getSeqName( header ) );
+      faiIdx.push_back( { 0, size_t( eol + 1 - start ), 0, 0 } );
+      isLastLine = false;
     }
+    else if ( !faiIdx.empty() )
+    {
+      // Every line of a contig except the last must be the same length
+      FaiEntry &entry = faiIdx.back();
+      if ( entry.lineBases == 0 )
+      {
+        entry.lineBases = bases;
+        entry.lineWidth = width;
+      }
+      else if ( isLastLine || bases > entry.lineBases ||
+        ( bases == entry.lineBases && width != entry.lineWidth ) )
+      {
+        isRegular = bases == 0 && eol + 1 >= end;
+      }
+      isLastLine = bases < entry.lineBases;
+      entry.len += bases;
+    }
+    pos = eol + 1;
+  }
+  munmap( data, sb.st_size );
+  if ( !isRegular || faiIdx.empty() )
+  {
+    seqNames.clear();
+    faiIdx.clear();
+    return false;
   }
-  ifs.close();
 
-  // Set the number of sequences included in the fasta file
-  maxSeqIdx = seqIdx;
+  // Write the index. If the directory is not writable the index is only
+  // kept in memory
+  std::ofstream ofs( faiPath.c_str() );
+  if ( ofs.fail() || !ofs.is_open() ) return true;
+  for ( unsigned int i = 0; i < faiIdx.size(); i++ )
+  {
+    ofs << faiNames[i] << '\t' << faiIdx[i].len << '\t' << faiIdx[i].offset
+        << '\t' << faiIdx[i].lineBases << '\t' << faiIdx[i].lineWidth << '\n';
+  }
+  ofs.close();
+  return true;
+}
 
-  // Convert the sequence to upper-case
-  convertToUper();
+void BioSeq::readFaiSeq(
+  const unsigned int seqIdx, const size_t startPos, const size_t len,
+  char* out
+  ) const
+{
+  if ( len == 0 ) return;
+
+  // Calculate the positions of the first and last residues in the file
+  const FaiEntry &entry = faiIdx[ seqIdx ];
+  size_t first = getFaiOffset( entry, startPos );
+  size_t last  = getFaiOffset( entry, startPos + len - 1 );
+
+  // Read the bytes spanning the residues
+  std::string buf( last - first + 1, '\0' );
+  size_t nRead = 0;
+  int    fd    = idxFd ? *idxFd : open( getIdxFasta().c_str(), O_RDONLY );
+  while ( fd != -1 && nRead < buf.size() )
+  {
+    ssize_t n = pread( fd, &buf[ nRead ], buf.size() - nRead, first + nRead );
+    if ( n <= 0 ) break;
+    nRead += n;
+  }
+  if ( !idxFd && fd != -1 ) close( fd );
+  if ( nRead < buf.size() )
+  {
+    std::cout << "Failed to read the fasta file: " << getIdxFasta()
+              << std::endl;
+    exit(1);
+  }
 
-  // Finished. Return true to indicate the the genome was parsed properly
+  // Normalize the residues in place to remove the line endings
+  SeqStats stats;
+  size_t   outLen = normalizeSeq( buf.data(), buf.size(), &buf[0], stats );
+  memcpy( out, buf.data(), std::min( outLen, len ) );
+}
+
+void BioSeq::openIdxFasta()
+{
+  idxFd.reset();
+  int fd = open( getIdxFasta().c_str(), O_RDONLY );
+  if ( fd == -1 ) return;
+  idxFd = std::shared_ptr< int >( new int( fd ), []( int* fd )
+    {
+      close( *fd );
+      delete fd;
+    } );
+}
+
+size_t BioSeq::getFaiOffset( const FaiEntry &entry, const size_t pos )
+{
+  return entry.offset + pos / entry.lineBases * entry.lineWidth +
+    pos % entry.lineBases;
+}
+
+const std::string& BioSeq::getIdxFasta() const
+{
+  return spillPath.empty() ? faPath : spillPath;
+}
+
+bool BioSeq::releaseSeqs( const std::string &spillDir )
+{
+  // Sequences read from the fasta file are not held in memory
+  if ( lazy ) return true;
+
+  // Keep the names of the contigs, which are replaced when the fasta file
+  // is indexed
+  std::vector< std::string > names = seqNames;
+
+  // The index must describe the same contigs that were parsed
+  auto isMatch = [this, &names]()
+  {
+    if ( faiIdx.size() != names.size() ) return false;
+    for ( unsigned int i = 0; i < faiIdx.size(); i++ )
+      if ( faiIdx[i].len != getSeqLen( i ) ) return false;
+    return true;
+  };
+
+  // Index the fasta file if it can be accessed randomly, otherwise write an
+  // uncompressed copy of the sequences and index that instead
+  std::string faiPath   = faPath + ".fai";
+  bool        isIndexed = !compressed && faPath != "-" &&
+    ( readFai( faiPath ) || buildFai( faiPath ) ) && isMatch();
+  if ( !isIndexed )
+  {
+    spillPath = spillDir + std::to_string( getpid() ) + "_" +
+      hashToHex( hashString( faPath + std::to_string( seqBuf.size() ) ) ) +
+      ".fasta";
+    FastaWriter writer( 80 );
+    for ( unsigned int i = 0; i < names.size(); i++ )
+      writer.addSeq( this, i, 0, getSeqLen( i ), names[i] );
+    isIndexed = writer.write( spillPath ) && buildFai( spillPath + ".fai" ) &&
+      isMatch();
+  }
+  seqNames = names;
+  if ( !isIndexed )
+  {
+    faiIdx.clear();
+    spillPath.clear();
+    return false;
+  }
+
+  // Free the sequences. They are read from the file from now on
+  lazy = true;
+  openIdxFasta();
+  seqBuf.clear();
   return true;
 }
 
-// Create a vector with the names of the contigs including the fasta headers
-std::vector< std::string > BioSeq::getSeqNames()
+bool BioSeq::isResident() const
 {
-  return seqNames;
+  return !lazy;
+}
+
+size_t BioSeq::memUsage() const
+{
+  return seqBuf.memUsage();
+}
+
+uint64_t BioSeq::hashSeqs() const
+{
+  const size_t blockSize = 1 << 20; // Number of residues decoded at a time
+  std::string  block;
+  uint64_t     hash = 0;
+
+  // The name and length of each contig are hashed before its residues, so
+  // the boundaries between contigs are part of the hash
+  for ( unsigned int i = 0; i < seqNames.size(); i++ )
+  {
+    size_t len = getSeqLen( i );
+    hash = hashCombine( hashString( seqNames[i], hash ), len );
+    for ( size_t pos = 0; pos < len; pos += blockSize )
+    {
+      size_t n = std::min( blockSize, len - pos );
+      block.resize( n );
+      decodeSeq( i, pos, n, &block[0] );
+      hash = hashBytes( block.data(), n, hash );
+    }
+  }
+  return hash;
+}
+
+void BioSeq::maskSeqs( const unsigned int minLen )
+{
+  const size_t blockSize = 1 << 20;         // Residues decoded at a time
+  const size_t overlap   = dustWinLen - 1;  // Residues shared by the blocks
+  std::string  block;
+
+  softMasks.assign( seqNames.size(), {} );
+  exclusions.assign( seqNames.size(), {} );
+  for ( unsigned int i = 0; i < seqNames.size(); i++ )
+  {
+    size_t len      = getSeqLen( i );
+    auto   &removed = exclusions[i];
+    if ( len < minLen )
+    {
+      removed.push_back( { 0, len } );
+      continue;
+    }
+
+    // Each block starts with the last residues of the block before it, so
+    // the windows that span the edges of the blocks are scored
+    size_t runStart = 0; // First residue of the current run of non bases
+    for ( size_t pos = 0; pos < len; pos += blockSize )
+    {
+      size_t start = pos > overlap ? pos - overlap : 0;
+      size_t end   = std::min( pos + blockSize, len );
+      block.resize( end - start );
+      decodeSeq( i, start, end - start, &block[0] );
+      findLowComplexity( block.data(), block.size(), start, softMasks[i] );
+      for ( size_t p = pos; p < end; p++ )
+      {
+        switch ( block[ p - start ] )
+        {
+          case 'A': case 'C': case 'G': case 'T':
+          case 'a': case 'c': case 'g': case 't':
+            if ( p - runStart >= minNRun ) removed.push_back( { runStart, p } );
+            runStart = p + 1;
+            break;
+          default:
+            break;
+        }
+      }
+    }
+    if ( len - runStart >= minNRun ) removed.push_back( { runStart, len } );
+
+    // The pieces of the contig between the runs that are shorter than the
+    // minimum length are also excluded
+    std::vector< std::pair< size_t, size_t > > pieces;
+    size_t pieceStart = 0;
+    removed.push_back( { len, len } );
+    for ( const auto &region : removed )
+    {
+      if ( region.first >= pieceStart + minLen )
+        pieces.push_back( { pieceStart, region.first } );
+      pieceStart = region.second;
+    }
+    removed.clear();
+    size_t prevEnd = 0;
+    for ( const auto &piece : pieces )
+    {
+      if ( piece.first > prevEnd )
+        removed.push_back( { prevEnd, piece.first } );
+      prevEnd = piece.second;
+    }
+    if ( prevEnd < len ) removed.push_back( { prevEnd, len } );
+  }
+}
+
+bool BioSeq::isMasked() const
+{
+  return !exclusions.empty();
+}
+
+std::vector< std::pair< size_t, size_t > > BioSeq::getSearchedRegions(
+  const unsigned int seqIdx
+  ) const
+{
+  size_t len = getSeqLen( seqIdx );
+  if ( !isMasked() ) return { { 0, len } };
+  std::vector< std::pair< size_t, size_t > > regions;
+  size_t start = 0;
+  for ( const auto &region : exclusions[ seqIdx ] )
+  {
+    if ( region.first > start ) regions.push_back( { start, region.first } );
+    start = region.second;
+  }
+  if ( start < len ) regions.push_back( { start, len } );
+  return regions;
+}
+
+size_t BioSeq::getNumSoftMasked() const
+{
+  size_t nMasked = 0;
+  for ( const auto &regions : softMasks )
+    for ( const auto &region : regions )
+      nMasked += region.second - region.first;
+  return nMasked;
+}
+
+size_t BioSeq::getNumExcluded() const
+{
+  size_t nExcluded = 0;
+  for ( const auto &regions : exclusions )
+    for ( const auto &region : regions )
+      nExcluded += region.second - region.first;
+  return nExcluded;
+}
+
+void BioSeq::applySoftMask(
+  const unsigned int seqIdx, const size_t startPos, const size_t len,
+  char* seq
+  ) const
+{
+  if ( !isMasked() ) return;
+  for ( size_t i = 0; i < len; i++ ) seq[i] = toupper( seq[i] );
+
+  // Lower case the regions that overlap the residues, starting from the
+  // first region that ends after the first residue
+  size_t endPos = startPos + len;
+  for ( const auto* regions : { &softMasks[ seqIdx ], &exclusions[ seqIdx ] } )
+  {
+    auto it = std::partition_point( regions->begin(), regions->end(),
+      [startPos]( const std::pair< size_t, size_t > &region )
+      { return region.second <= startPos; } );
+    for ( ; it != regions->end() && it->first < endPos; it++ )
+    {
+      size_t first = std::max( it->first, startPos );
+      size_t last  = std::min( it->second, endPos );
+      for ( size_t p = first; p < last; p++ )
+        seq[ p - startPos ] = tolower( seq[ p - startPos ] );
+    }
+  }
+}
+
+bool BioSeq::streamFasta( int fd )
+{
+  const size_t blockSize = 1 << 16;           // Bytes read per system call
+  std::vector< char > block( blockSize );     // Block read from the file
+  std::string         buf;                    // Data that has not been indexed
+  z_stream            zs;                     // Zlib stream state
+  bool                isFirst = true;         // True for the first block
+  ssize_t             nRead;                  // Number of bytes read
+
+  memset( &zs, 0, sizeof( zs ) );
+  while ( ( nRead = read( fd, block.data(), blockSize ) ) > 0 )
+  {
+    // Check the first block for the gzip magic number. Automatic header
+    // detection is used so that the members of BGZF files are also inflated.
+    if ( isFirst )
+    {
+      compressed = nRead >= 2 && uint8_t( block[0] ) == 0x1f &&
+        uint8_t( block[1] ) == 0x8b;
+      if ( compressed && inflateInit2( &zs, 15 + 32 ) != Z_OK ) return false;
+      isFirst = false;
+    }
+
+    if ( !compressed )
+    {
+      buf.append( block.data(), nRead );
+    } else {
+
+      // Inflate the block. Each time the end of a gzip member is reached the
+      // stream is reset to begin the next member.
+      zs.next_in  = reinterpret_cast< Bytef* >( block.data() );
+      zs.avail_in = nRead;
+      do
+      {
+        size_t offset = buf.size();
+        buf.resize( offset + 4 * blockSize );
+        zs.next_out  = reinterpret_cast< Bytef* >( &buf[ offset ] );
+        zs.avail_out = 4 * blockSize;
+        int ret = inflate( &zs, Z_NO_FLUSH );
+        buf.resize( offset + 4 * blockSize - zs.avail_out );
+
+        if ( ret == Z_STREAM_END )
+        {
+          inflateReset( &zs );
+        }
+        else if ( ret == Z_BUF_ERROR )
+        {
+          break;
+        }
+        else if ( ret != Z_OK )
+        {
+          std::cout << "Failed to decompress the fasta file: " << faPath
+                    << std::endl;
+          inflateEnd( &zs );
+          exit(1);
+        }
+      } while ( zs.avail_in > 0 || zs.avail_out == 0 );
+    }
+
+    // Index the complete lines and keep the partial line for the next block
+    size_t lastLine = buf.rfind( '\n' );
+    if ( lastLine != std::string::npos )
+    {
+      indexFasta( buf.data(), lastLine + 1 );
+      buf.erase( 0, lastLine + 1 );
+    }
+  }
+  if ( compressed ) inflateEnd( &zs );
+
+  // Index the final line if the file does not end with a new line
+  if ( !buf.empty() ) indexFasta( buf.data(), buf.size() );
+  checkSeqStats();
+  indexSeqNames();
+
+  return !seqNames.empty();
 }
 
-void BioSeq::convertToUper()
+void BioSeq::appendSeq( const char* seq, size_t len )
 {
-  // Any down stream steps with this structure will require it to be in
-  // upper case. Test if the first character is lowercase and if it is,
-  // transform the entire string to uppercase
-  if ( std::islower( seqs[0][0] ) )
+  // Normalize the residues and pack them into the buffer in blocks, then
+  // extend the end of the current contig
+  char block[ 1 << 14 ];
+  for ( size_t i = 0; i < len; i += sizeof( block ) )
   {
-    for ( auto &seq : seqs )
-      transform( seq.begin(), seq.end(), seq.begin(), ::toupper );
+    size_t n = std::min( len - i, sizeof( block ) );
+    seqBuf.append( block, normalizeSeq( seq + i, n, block, seqStats ) );
   }
+  seqStarts.back() = seqBuf.size();
+}
+
+void BioSeq::checkSeqStats() const
+{
+  if ( seqStats.nInvalid > 0 )
+  {
+    std::cout << "Warning: " << seqStats.nInvalid << " residues in " << faPath
+              << " are not IUPAC nucleotide codes" << std::endl;
+  }
+}
+
+// Create a vector with the names of the contigs including the fasta headers
+std::vector< std::string > BioSeq::getSeqNames()
+{
+  return seqNames;
 }
 
 // Set the path to the fasta file and parse the data.
@@ -151,28 +835,66 @@ std::string BioSeq::getSeqName( std::string &faHeader )
 // This function returns the whole genome sequence as a vector
 std::vector< std::string > BioSeq::getSeqs( )
 {
+  std::vector< std::string > seqs;
+  seqs.reserve( seqNames.size() );
+  for ( unsigned int i = 0; i < seqNames.size(); i++ )
+  {
+    std::string seq( getSeqLen( i ), '\0' );
+    decodeSeq( i, 0, seq.size(), &seq[0] );
+    seqs.push_back( seq );
+  }
   return seqs;
 }
 
+// Decode the residues of a contig from the packed sequence buffer
+void BioSeq::decodeSeq(
+  const unsigned int seqIdx, const size_t startPos, const size_t len,
+  char* out
+  ) const
+{
+  if ( lazy ) readFaiSeq( seqIdx, startPos, len, out );
+  else seqBuf.decode( seqStarts[ seqIdx ] + startPos, len, out );
+}
+
+size_t BioSeq::getSeqLen( const unsigned int seqIdx ) const
+{
+  if ( seqIdx + 1 >= seqStarts.size() ) return 0;
+  return seqStarts[ seqIdx + 1 ] - seqStarts[ seqIdx ];
+}
+
 
 // Find which contig
 bool BioSeq::getSeqIndex(
   const std::string &seqName, unsigned int &seqIdx
   ) const
 {
-  auto it = find( seqNames.begin(), seqNames.end(), seqName );
+  auto it = seqIdxMap.find( seqName );
   // If the name was not found return false
-  if ( it == seqNames.end() ) return false;
-  seqIdx = std::distance( seqNames.begin(), it );
+  if ( it == seqIdxMap.end() ) return false;
+  seqIdx = it->second;
   return true;
 }
 
+const std::string& BioSeq::getContigName( const unsigned int seqIdx ) const
+{
+  return seqNames[ seqIdx ];
+}
+
+void BioSeq::indexSeqNames()
+{
+  seqIdxMap.clear();
+  seqIdxMap.reserve( seqNames.size() );
+  for ( unsigned int i = 0; i < seqNames.size(); i++ )
+    seqIdxMap.emplace( seqNames[i], i );
+}
+
 // Free the memory associated with the whole genome sequence. The contig
 // names are retained. This function exists for instances where mimizing memory
 // usage is critical and keeping the whole genome sequence in memory
 void BioSeq::clearSeqs()
 {
-  seqs.clear();
+  seqBuf.clear();
+  seqStarts.assign( seqNames.size() + 1, 0 );
 }
 
 // This function parses sequences to retrieve the substring corresponding
@@ -191,14 +913,18 @@ bool BioSeq::getSeqAtCoord(
   if ( startPos >= endPos ) return false;
 
   // Check the the end of the sequence is not out of range
-  if ( endPos > seqs[ seqIdx ].size() ) return false;
+  if ( endPos > getSeqLen( seqIdx ) ) return false;
 
   // Update the sequence to return the substring for this contig. The start
-  // is decremented by one because it is one indexed
-  int len = endPos - startPos + 1;
+  // is decremented by one because it is one indexed. The range is clipped
+  // at the end of the contig
+  size_t len = std::min(
+    size_t( endPos - startPos + 1 ), getSeqLen( seqIdx ) - startPos
+    );
 
-  // Subset the
-  seq = seqs[ seqIdx ].substr( startPos, len );
+  // Decode the residues from the packed sequence
+  seq.resize( len );
+  decodeSeq( seqIdx, startPos, len, &seq[0] );
 
   return true;
 }
@@ -211,42 +937,26 @@ bool BioSeq::getSeqAtCoord(
   // Look up the name of the contig
   unsigned int seqIdx;
   if ( !getSeqIndex( seqName, seqIdx ) ) return false;
-
-  // Check that the requested direction is correct
-  if ( startPos >= endPos ) return false;
-
-  // Check the the end of the sequence is not out of range
-  if ( endPos > seqs[ seqIdx ].size() ) return false;
-
-  // Update the sequence to return the substring for this contig. The start
-  // is decremented by one because it is one indexed
-  int len = endPos - startPos + 1;
-
-  // Subset the
-  seq = seqs[ seqIdx ].substr( startPos, len );
-
-  return true;
+  return getSeqAtCoord( seqIdx, startPos, endPos, seq );
 }
 
 void BioSeq::addSeq( const std::string &faHeader, const std::string &seq )
 {
-  seqs.push_back( seq );
+  seqIdxMap.emplace( faHeader, seqNames.size() );
   seqNames.push_back( faHeader );
+  seqStarts.push_back( seqBuf.size() );
+  appendSeq( seq.data(), seq.size() );
+  maxSeqIdx = seqNames.size() - 1;
 }
 
 // Write the sequence in a multi-fasta file
-bool BioSeq::writeSeqs( std::string faPath )
+bool BioSeq::writeSeqs( std::string faPath ) const
 {
-  // Initialize the output file stream and open for writing
-  std::ofstream ofs;
-  ofs.open( faPath.c_str() );
-  if ( ofs.fail() || !ofs.is_open() ) return false;
-
-  for ( unsigned int i = 0; i < seqs.size(); i++ )
-    ofs << ">" << seqNames[ i ] << endl << seqs[ i ] << endl;
-
-  ofs.close();
-  return true;
+  // Decode each contig straight into the output buffer
+  FastaWriter writer;
+  for ( unsigned int i = 0; i < seqNames.size(); i++ )
+    writer.addSeq( this, i, 0, getSeqLen( i ), seqNames[ i ] );
+  return writer.write( faPath );
 }
 
 std::string BioSeq::getFasta() const
@@ -259,4 +969,14 @@ int BioSeq::nSeqs() const
   return maxSeqIdx;
 }
 
+bool BioSeq::isCompressed() const
+{
+  return compressed;
+}
+
+size_t BioSeq::getNumN() const
+{
+  return seqStats.nN;
+}
+
 // -----------------------------------------------------------------------------
@@ -1,9 +1,21 @@
 #include <vector>
 #include <string>
+#include <memory>
+#include <cstring>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <unordered_map>
 #include <stdlib.h>
 #include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "PackedSeq.h"
+#include "SeqKernel.h"
+#include "Dust.h"
 
 // -----------------------------------------------------------------------------
 // BioSeq
@@ -14,7 +26,16 @@
 // contents of a fasta file as a character vector representing the
 // contig, gene sequences, ect. The fasta headers until the first space are
 // stored in the "seqNames". If lowercase the sequence is converted to upper
-// case.
+// case. The residues of every contig are stored back to back in a single
+// buffer, with the offset of each contig recorded in "seqStarts". The buffer
+// is packed with two bits per base (see "PackedSeq"). Fasta files are memory
+// mapped and indexed in a single pass. Gzip and BGZF compressed files, and
+// fasta files piped on stdin (path "-"), are decompressed and indexed block
+// by block as they are read. Alternatively, uncompressed fasta files can be
+// loaded lazily from a samtools compatible ".fai" index, in which case only
+// the requested residues are read from the file. Parsed sequences can be
+// saved to and restored from a binary cache file to skip parsing on
+// subsequent runs.
 // -----------------------------------------------------------------------------
 
 #ifndef _BIO_SEQ_
@@ -32,6 +53,12 @@ public:
   BioSeq( const std::string &faPath ): faPath( faPath )
   { ; }
 
+  // Copy and move ctors and assignment
+  BioSeq( const BioSeq &rhs ) = default;
+  BioSeq( BioSeq &&rhs ) = default;
+  BioSeq& operator=( const BioSeq &rhs ) = default;
+  BioSeq& operator=( BioSeq &&rhs ) = default;
+
   // Dtor: does noting
   ~BioSeq()
   { ; }
@@ -46,22 +73,64 @@ public:
   // Parses the fasta file from a vector of strings
   bool parseFasta( std::vector< std::string > &faSeq );
 
+  // Load the contig names and lengths from the ".fai" index of the fasta
+  // file without reading the sequences. The index is created if it does not
+  // exist. Sequences are read from the file when they are requested. Falls
+  // back to "parseFasta" for files that can not be accessed randomly.
+  bool parseFai();
+
   // Write the sequence in a multi-fasta file
-  bool writeSeqs( std::string faPath );
+  bool writeSeqs( std::string faPath ) const;
+
+  // Load the parsed sequences from a binary cache file written by
+  // "writeCache". Returns false if the cache does not exist, is corrupt, or
+  // the size or modification time of the fasta file have changed.
+  bool readCache( const std::string &cachePath );
+
+  // Write the parsed sequences, contig names and sizes to a binary cache file
+  bool writeCache( const std::string &cachePath ) const;
 
   // This function returns the sequence as a vector
   std::vector< std::string > getSeqs();
 
+  // Decode "len" residues of the contig at the input index starting at
+  // "startPos" into the character array "out". The range must be valid
+  void decodeSeq( const unsigned int seqIdx, const size_t startPos,
+    const size_t len, char* out ) const;
+
+  // Return the number of residues in the contig at the input index
+  size_t getSeqLen( const unsigned int seqIdx ) const;
+
   // Find the index of the input seq name. If the name is found the "seqIdx"
   // variable is updated and true is returned. False is returned if the
   // seq name is not found
   bool getSeqIndex( const std::string &seqName, unsigned int &seqIdx ) const;
 
+  // Return the name of the contig at the input index
+  const std::string& getContigName( const unsigned int seqIdx ) const;
+
   // Free the memory associated with the whole genome sequence. The contig
   // names are retained. This function exists for instances where
   // it is important to mimize memory usage
   void clearSeqs();
 
+  // Release the memory used by the sequences, which are then read from disk
+  // when they are requested, as in lazy mode. Uncompressed fasta files are
+  // read through their ".fai" index. Other sequences are first written to
+  // an uncompressed fasta file in "spillDir". The contig names and lengths
+  // are retained. Returns false if the sequences could not be released.
+  bool releaseSeqs( const std::string &spillDir );
+
+  // Returns true if the sequences are held in memory
+  bool isResident() const;
+
+  // Return the approximate number of bytes used by the sequences
+  size_t memUsage() const;
+
+  // Return a hash of the contig names and residues, which identifies the
+  // contents of the genome independently of the fasta file it was read from
+  uint64_t hashSeqs() const;
+
   // Create a vector with the names of the contigs including the fasta headers
   std::vector< std::string > getSeqNames();
 
@@ -82,9 +151,41 @@ public:
   // Get the number of contigs in this genome
   int nSeqs() const;
 
+  // Returns true if the fasta file is gzip or BGZF compressed
+  bool isCompressed() const;
+
+  // Return the number of N's in the sequences that were parsed
+  size_t getNumN() const;
+
   // Add a sequence to the this BioSeq
   void addSeq( const std::string &faHeader, const std::string &seq );
 
+  // Find the regions of each contig that can not hold an alignment of at
+  // least "minLen" nts, which are excluded from the searches: contigs
+  // shorter than "minLen", runs of at least "minNRun" residues that are not
+  // bases, and the pieces left between them that are shorter than "minLen".
+  // Low complexity regions (see "findLowComplexity") are soft masked: they
+  // are searched, but are not used to seed alignments
+  void maskSeqs( const unsigned int minLen );
+
+  // Returns true if the contigs have been masked
+  bool isMasked() const;
+
+  // Return the regions of the contig that are not excluded, as zero based,
+  // half open intervals. The whole contig if the contigs are not masked
+  std::vector< std::pair< size_t, size_t > > getSearchedRegions(
+    const unsigned int seqIdx ) const;
+
+  // Return the number of residues that are soft masked, and excluded
+  size_t getNumSoftMasked() const;
+  size_t getNumExcluded() const;
+
+  // Convert the "len" residues at "seq", starting at "startPos" in the
+  // contig at "seqIdx", to lower case if they are soft masked or excluded
+  // and to upper case otherwise. Does nothing if the contigs are not masked
+  void applySoftMask( const unsigned int seqIdx, const size_t startPos,
+    const size_t len, char* seq ) const;
+
 private:
 
   // Allow access from genome class and msa class
@@ -93,17 +194,103 @@ private:
   // The path to the fasta file corresponding to this genome sequence
   std::string faPath;
 
-  // The sequece contained in the fasta file
-  std::vector < std::string > seqs;
+  // The residues of all of the contigs in the fasta file, concatenated
+  PackedSeq seqBuf;
+
+  // Offset of each contig in "seqBuf". The final element is the size of the
+  // buffer so that the length of contig i is seqStarts[i+1] - seqStarts[i]
+  std::vector < size_t > seqStarts = { 0 };
 
   // The names assigned to each contig
   std::vector < std::string > seqNames;
 
+  // Index of each contig name in "seqNames"
+  std::unordered_map< std::string, unsigned int > seqIdxMap;
+
+  // Create the map of contig names to indexes after the contigs are parsed
+  void indexSeqNames();
+
   // Parse the fasta header to get the contig names
   std::string getSeqName( std::string &faHeader );
 
-  // Convert the sequence to upper case
-  void convertToUper();
+  // Scan a buffer with the contents of a fasta file. Contig names are parsed
+  // from the headers and the residues are appended to "seqBuf"
+  void indexFasta( const char* data, const size_t size );
+
+  // Append raw sequence to the current contig. The sequence may span
+  // multiple lines; it is normalized by "normalizeSeq" as it is packed
+  void appendSeq( const char* seq, size_t len );
+
+  // Print a warning if residues outside of the IUPAC alphabet were parsed
+  void checkSeqStats() const;
+
+  // Counts of N's and invalid residues in the parsed sequences
+  SeqStats seqStats;
+
+  // Shortest run of residues that are not bases that is excluded
+  static constexpr size_t minNRun = 50;
+
+  // Soft masked and excluded regions of each contig, sorted and disjoint.
+  // Empty until the contigs are masked
+  std::vector< std::vector< std::pair< size_t, size_t > > > softMasks;
+  std::vector< std::vector< std::pair< size_t, size_t > > > exclusions;
+
+  // Identifies the format of the binary cache files
+  static constexpr char cacheMagic[9] = "PEARLGC1";
+
+  // Read a fasta file from a file descriptor one block at a time. If the
+  // first block has the gzip magic number the stream is inflated.
+  bool streamFasta( int fd );
+
+  // Position of a contig in the fasta file, as stored in a ".fai" index
+  struct FaiEntry
+  {
+    size_t       len;       // Number of residues in the contig
+    size_t       offset;    // Offset of the first residue in the file
+    unsigned int lineBases; // Number of residues per line
+    unsigned int lineWidth; // Number of bytes per line, with the new line
+  };
+
+  // Index of each contig in the fasta file. Only set in lazy mode
+  std::vector< FaiEntry > faiIdx;
+
+  // Uncompressed copy of the sequences written by "releaseSeqs", when the
+  // fasta file can not be accessed randomly
+  std::string spillPath;
+
+  // Return the path to the file the ".fai" index refers to
+  const std::string& getIdxFasta() const;
+
+  // True if the sequences are read from the fasta file when requested
+  bool lazy = false;
+
+  // Descriptor of the file the index refers to, which is kept open while
+  // the sequences are read from it and closed with the last copy of this
+  // object. Null if it could not be opened, in which case the file is
+  // opened for each read
+  std::shared_ptr< int > idxFd;
+
+  // Open the file the index refers to, for "readFaiSeq"
+  void openIdxFasta();
+
+  // Return the offset in the fasta file of the residue at "pos" of a contig
+  static size_t getFaiOffset( const FaiEntry &entry, const size_t pos );
+
+  // Read the ".fai" index at the input path. Returns false if the index does
+  // not exist, is older than the fasta file, or has an entry with line
+  // lengths that are not valid or residues past the end of the file
+  bool readFai( const std::string &faiPath );
+
+  // Scan the fasta file to create the index and write it to the input path.
+  // Returns false if the lines of a contig are not all the same length
+  bool buildFai( const std::string &faiPath );
+
+  // Read residues of a contig from the fasta file using the index
+  void readFaiSeq( const unsigned int seqIdx, const size_t startPos,
+    const size_t len, char* out ) const;
+
+  // True if the fasta file is gzip compressed
+  bool compressed = false;
 
   // Maximium index of the contigs
   unsigned int maxSeqIdx;
@@ -0,0 +1,120 @@
+#include "BlastAligner.h"
+namespace fs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+// BlastAligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+
+// ---- BlastAligner member functions ------------------------------------------
+
+std::string BlastAligner::getVersion()
+{
+  return getProgramOutput( { "blastn", "-version" } );
+}
+
+std::string BlastAligner::getParams() const
+{
+  return std::string( "-outfmt " ) + outFields;
+}
+
+bool BlastAligner::canCombine() const
+{
+  return true;
+}
+
+bool BlastAligner::indexRanges(
+  const Genome* genome, const std::vector< SeqRange > &ranges,
+  const std::string &idxPath
+  )
+{
+  // The fasta file is read directly if the ranges are its contigs under
+  // their own names. Other ranges are written with local ids, which are
+  // kept by "-parse_seqids". A title is required when reading from a pipe
+  bool isRenamed = ranges.size() != genome->getNumContigs();
+  for ( unsigned int i = 0; !isRenamed && i < ranges.size(); i++ )
+  {
+    isRenamed = ranges[i].seqIdx != i || ranges[i].startPos != 0 ||
+      ranges[i].len != genome->getSeqLen( i ) ||
+      ranges[i].name != genome->getContigName( i );
+  }
+  bool isPiped = isRenamed || isPipedInput( genome );
+  std::vector< std::string > args = { "makeblastdb", "-dbtype", "nucl",
+    "-in", isPiped ? "-" : genome->getFasta(),
+    "-title", genome->getGenomeName(), "-out", idxPath };
+  if ( isRenamed ) args.push_back( "-parse_seqids" );
+
+  std::vector< SeqRange > idxRanges = ranges;
+  if ( isRenamed )
+    for ( auto &range : idxRanges ) range.name = "lcl|" + range.name;
+
+  // Discard the progress messages
+  return runProgram( args, isPiped ? genome : nullptr, idxRanges,
+    []( std::string & /* line */ ) { ; } );
+}
+
+bool BlastAligner::combineIndexes(
+  const std::vector< std::string > &idxPaths, const std::string &outPath
+  )
+{
+  // An alias file lists the databases, which blastn searches as a single
+  // database. Databases that are listed more than once are listed once
+  std::set< std::string > listed;
+  std::ofstream ofs( ( outPath + ".nal" ).c_str() );
+  if ( !ofs.is_open() ) return false;
+  ofs << "TITLE " << fs::path( outPath ).filename().string() << '\n'
+      << "DBLIST";
+  for ( const auto &idxPath : idxPaths )
+  {
+    if ( !listed.insert( idxPath ).second ) continue;
+    ofs << " \"" << fs::absolute( idxPath ).string() << "\"";
+  }
+  ofs << '\n';
+  ofs.close();
+  return !ofs.fail();
+}
+
+bool BlastAligner::search(
+  const Genome*                               query,
+  const std::vector< SeqRange >*              ranges,
+  const std::string                           &idxPath,
+  const uint32_t                              nSubjSeqs,
+  const std::function< void( AlignRecord& ) > &onHit
+  )
+{
+  // Every hit of a query contig must be reported, not only those against
+  // the first 500 subject contigs. Masked queries are written in lower
+  // case where they are masked, which blastn does not seed from
+  bool isPiped = ranges != nullptr || isPipedInput( query ) ||
+    query->isMasked();
+  std::vector< std::string > args = { "blastn",
+    "-query", isPiped ? "-" : query->getFasta(), "-db", idxPath,
+    "-outfmt", outFields, "-max_target_seqs",
+    std::to_string( std::max( nSubjSeqs, uint32_t( 500 ) ) ) };
+  if ( query->isMasked() ) args.push_back( "-lcase_masking" );
+
+  std::vector< SeqRange > genomeRanges;
+  if ( ranges == nullptr && isPiped ) genomeRanges = getGenomeRanges( query );
+  AlignRecord rec;
+  return runProgram( args, isPiped ? query : nullptr,
+    ranges != nullptr ? *ranges : genomeRanges,
+    [&]( std::string &line ) { if ( parseLine( line, rec ) ) onHit( rec ); } );
+}
+
+bool BlastAligner::parseLine(
+  const std::string &line, AlignRecord &rec
+  ) const
+{
+  if ( line.empty() ) return false;
+  std::stringstream ss( line );
+  ss >> rec.qName >> rec.sName >> rec.qStart >> rec.qEnd >> rec.sStart
+     >> rec.sEnd >> rec.length >> rec.pIdent;
+  if ( ss.fail() ) return false;
+
+  // Local ids may be reported with their "lcl|" prefix
+  if ( rec.sName.compare( 0, 4, "lcl|" ) == 0 ) rec.sName.erase( 0, 4 );
+  return true;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,65 @@
+#include "Aligner.h"
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+
+// -----------------------------------------------------------------------------
+// BlastAligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+// This class aligns genomes with blastn. The index of a genome is a blast
+// database made by makeblastdb. Databases are combined with a blast alias
+// file. The hits are read from the tabular output of blastn as it is
+// written. Fasta files that blast can not read directly, because they are
+// compressed or were read from stdin, are written to the programs from
+// memory.
+// -----------------------------------------------------------------------------
+
+#ifndef _BLAST_ALIGNER_
+#define _BLAST_ALIGNER_
+class BlastAligner: public Aligner
+{
+public:
+
+  // Default ctor
+  BlastAligner()
+  { ; }
+
+  // Dtor
+  ~BlastAligner()
+  { ; }
+
+  std::string getVersion();
+
+  std::string getParams() const;
+
+  bool canCombine() const;
+
+  // Make a blast database of the ranges of the genome. Ranges that are not
+  // the contigs under their own names are parsed by makeblastdb as local ids
+  bool indexRanges( const Genome* genome,
+    const std::vector< SeqRange > &ranges, const std::string &idxPath );
+
+  // Write a blast alias file listing the databases by their absolute paths
+  bool combineIndexes( const std::vector< std::string > &idxPaths,
+    const std::string &outPath );
+
+  bool search( const Genome* query, const std::vector< SeqRange >* ranges,
+    const std::string &idxPath, const uint32_t nSubjSeqs,
+    const std::function< void( AlignRecord& ) > &onHit );
+
+private:
+
+  // Output format passed to blastn
+  static constexpr char outFields[] =
+    "6 qseqid sseqid qstart qend sstart send length pident";
+
+  // Parse a line of the tabular output of blastn. Returns false if the line
+  // is empty or malformed
+  bool parseLine( const std::string &line, AlignRecord &rec ) const;
+};
+#endif
+
+// -----------------------------------------------------------------------------
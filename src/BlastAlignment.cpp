@@ -21,7 +21,7 @@ bool operator>( const Subject & lhs, const Subject & rhs );
 bool operator<( const BlastAlignment &lhs, const BlastAlignment &rhs )
 {
   // If this sequences are on different contigs, return which is less
-  // by comparing the two strings
+  // by comparing the contig ids
   if ( lhs.qSeqId != rhs.qSeqId ) return lhs.qSeqId < rhs.qSeqId;
 
 
@@ -37,7 +37,7 @@ bool operator<( const BlastAlignment &lhs, const BlastAlignment &rhs )
 bool operator>( const BlastAlignment &lhs, const BlastAlignment &rhs )
 {
   // If this sequences are on different contigs, return which is less
-  // by comparing the two strings
+  // by comparing the contig ids
   if ( lhs.qSeqId != rhs.qSeqId ) return lhs.qSeqId > rhs.qSeqId;
 
 
@@ -92,14 +92,16 @@ BlastAlignment::BlastAlignment(
   )
 {
   // Variable initializtaions for the subject data
-  std::string sSeqId;
+  std::string qSeqName;
+  std::string sSeqName;
+  uint32_t    sSeqId;
   int         sStart;
   int         sEnd;
   double      pIdnet;
 
   // Assign the values from the string strem to the variables
-  ss >> qSeqId;
-  ss >> sSeqId;
+  ss >> qSeqName;
+  ss >> sSeqName;
   ss >> qStart;
   ss >> qEnd;
   ss >> sStart;
@@ -121,6 +123,16 @@ BlastAlignment::BlastAlignment(
 
   this->query = qry;
 
+  // Look up the ids of the contigs once, so that alignments are compared
+  // without using the names
+  if ( !qry->getSeqId( qSeqName, qSeqId ) ||
+    !subj->getSeqId( sSeqName, sSeqId ) )
+  {
+    std::cout << "Contig in the blast results was not found in the genomes: "
+              << qSeqName << ", " << sSeqName << std::endl;
+    exit( 1 );
+  }
+
   // Create the subject class object
   Subject subject( sSeqId, qStart, qEnd, sStart, sEnd, length, pIdnet, subj );
   subjects.push_back( subject );
@@ -142,8 +154,8 @@ void BlastAlignment::printAlign()
 {
   for ( int i = 0; i < 80; i++ ) std::cout << '-';
   std::cout << std::endl  << "Query: " << query->getGenomeName() << ": "
-            << qSeqId << "; Length: " << length << "; Position: "
-            << qStart << "-" << qEnd << std::endl
+            << query->getSeqIdName( qSeqId ) << "; Length: " << length
+            << "; Position: " << qStart << "-" << qEnd << std::endl
             << "  -- " << subjects.size() << " subjects "
             << "within this alignment:" << std::endl;
   for ( auto it = subjects.begin(); it != subjects.end(); it++ )
@@ -193,9 +205,16 @@ bool  BlastAlignment::getAlignSeq(
   std::string &seqId, std::string &seq
   )
 {
-  seqId = query->getGenomeName() + ":" + qSeqId + ";" +
-    std::to_string( qStart ) + "-" + std::to_string( qEnd );
-  return query->getSeqAtCoord( qSeqId, qStart, qEnd, seq );
+  seqId = getAlignName();
+  return query->getSeqAtCoord(
+    query->getSeqIdx( qSeqId ), qStart, qEnd, seq
+    );
+}
+
+std::string BlastAlignment::getAlignName() const
+{
+  return query->getGenomeName() + ":" + query->getSeqIdName( qSeqId ) +
+    ";" + std::to_string( qStart ) + "-" + std::to_string( qEnd );
 }
 
 void BlastAlignment::setStartPos( const unsigned int newStart )
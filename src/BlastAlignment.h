@@ -39,7 +39,7 @@ struct BlastAlignment
   ~BlastAlignment();
 
   const Genome*          query;    // Pointer to the genome of the query
-  std::string            qSeqId;   // Seq name of the subject
+  uint32_t               qSeqId;   // Contig id of the query
   unsigned int           qStart;   // Start of alignment in query
   unsigned int           qEnd;     // End of alignment in query
   unsigned int           length;   // Length of the alignment
@@ -66,6 +66,9 @@ struct BlastAlignment
   // sucessfully updated.
   bool getAlignSeq( std::string &seqId, std::string &seq );
 
+  // Return the seq id used for the aligned sequence in the query
+  std::string getAlignName() const;
+
   void setStartPos( const unsigned int newStart );
 
   void setEndPos( const unsigned int newEnd );
@@ -0,0 +1,231 @@
+#include "BlastCache.h"
+namespace fs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+// BlastCache
+// Ryan D. Crawford
+// 2020/07/21
+// -----------------------------------------------------------------------------
+
+// ---- BlastCache member functions --------------------------------------------
+
+BlastCache::BlastCache(
+  const std::string &cacheDir,
+  const std::string &runDbDir,
+  const std::string &alignerVersion,
+  const std::string &params
+  )
+{
+  if ( cacheDir.empty() )
+  {
+    dbDir = runDbDir;
+    fs::create_directories( dbDir );
+    return;
+  }
+
+  // Databases only depend on the aligner, while hits also depend on the
+  // parameters of the search
+  std::string key = alignerVersion + '\n' + params;
+  dbDir  = cacheDir + "dbs/" + hashToHex( hashString( alignerVersion ) ) + '/';
+  hitDir = cacheDir + "hits/" + hashToHex( hashString( key ) ) + '/';
+  fs::create_directories( dbDir );
+  fs::create_directories( hitDir );
+
+  // Describe the key of the hits so the cache can be inspected
+  std::string keyPath = hitDir + "key.txt";
+  if ( !fs::exists( keyPath ) )
+  {
+    std::ofstream ofs( keyPath.c_str() );
+    ofs << key << '\n';
+  }
+}
+
+bool BlastCache::isEnabled() const
+{
+  return !hitDir.empty();
+}
+
+std::string BlastCache::getDbPath(
+  const uint64_t genomeHash, const std::string &variant
+  ) const
+{
+  std::string dbPath = dbDir + hashToHex( genomeHash );
+  if ( !variant.empty() ) dbPath += "_" + variant;
+  return dbPath;
+}
+
+bool BlastCache::hasDb( const std::string &dbPath ) const
+{
+  return isEnabled() && fs::exists( dbPath + ".done" );
+}
+
+std::string BlastCache::getTmpDbPath( const std::string &dbPath ) const
+{
+  // Databases in the directory of the run are only built by this process
+  if ( !isEnabled() ) return dbPath;
+  char host[256] = { 0 };
+  if ( gethostname( host, sizeof( host ) - 1 ) != 0 ) host[0] = '\0';
+  return dbPath + "_tmp_" + std::string( host ) + "_" +
+    std::to_string( getpid() );
+}
+
+bool BlastCache::commitDb(
+  const std::string &tmpPath, const std::string &dbPath
+  ) const
+{
+  if ( !isEnabled() || tmpPath == dbPath ) return true;
+
+  // The database is made of the files named after its path followed by an
+  // extension
+  std::string tmpName = fs::path( tmpPath ).filename().string() + ".";
+  std::string dbName  = fs::path( dbPath ).filename().string() + ".";
+  std::vector< std::string > tmpFiles;
+  std::error_code ec;
+  for ( const auto &entry : fs::directory_iterator( dbDir, ec ) )
+  {
+    std::string name = entry.path().filename().string();
+    if ( name.compare( 0, tmpName.size(), tmpName ) == 0 )
+      tmpFiles.push_back( name );
+  }
+  if ( hasDb( dbPath ) )
+  {
+    for ( const auto &name : tmpFiles ) remove( ( dbDir + name ).c_str() );
+    return true;
+  }
+  for ( const auto &name : tmpFiles )
+  {
+    std::string newPath = dbDir + dbName + name.substr( tmpName.size() );
+    if ( rename( ( dbDir + name ).c_str(), newPath.c_str() ) != 0 )
+      return false;
+  }
+
+  // The marker is written last, so the database is only used once all of
+  // its files are in place
+  std::ofstream ofs( ( dbPath + ".done" ).c_str() );
+  return ofs.is_open();
+}
+
+std::string BlastCache::getHitPath(
+  const uint64_t queryHash, const uint64_t subjHash
+  ) const
+{
+  return hitDir + hashToHex( queryHash ) + "_" + hashToHex( subjHash ) +
+    ".pbh";
+}
+
+bool BlastCache::readHits(
+  const uint64_t queryHash, const uint64_t subjHash,
+  std::vector< BlastHit > &hits
+  ) const
+{
+  struct stat sb;
+  char        magic[8];
+  uint64_t    payloadHash;
+
+  if ( !isEnabled() ) return false;
+
+  // Read the whole file with a single read
+  int fd = open( getHitPath( queryHash, subjHash ).c_str(), O_RDONLY );
+  if ( fd == -1 ) return false;
+  if ( fstat( fd, &sb ) == -1 )
+  {
+    close( fd );
+    return false;
+  }
+  std::string buf( sb.st_size, '\0' );
+  size_t nRead = 0;
+  while ( nRead < buf.size() )
+  {
+    ssize_t n = read( fd, &buf[ nRead ], buf.size() - nRead );
+    if ( n <= 0 ) break;
+    nRead += n;
+  }
+  close( fd );
+  if ( nRead < buf.size() ) return false;
+
+  // Check the header and the contents against the hash
+  const char* pos = buf.data();
+  const char* end = buf.data() + buf.size();
+  if ( !getValue( pos, end, magic ) || memcmp( magic, hitMagic, 8 ) != 0 )
+    return false;
+  if ( !getValue( pos, end, payloadHash ) ||
+    hashBytes( pos, end - pos ) != payloadHash )
+  {
+    return false;
+  }
+
+  return getHits( pos, end, hits );
+}
+
+bool BlastCache::writeHits(
+  const uint64_t queryHash, const uint64_t subjHash,
+  const std::vector< BlastHit > &hits
+  ) const
+{
+  if ( !isEnabled() ) return false;
+
+  std::string payload;
+  putHits( payload, hits );
+  std::string header;
+  header.append( hitMagic, 8 );
+  putValue( header, hashBytes( payload.data(), payload.size() ) );
+
+  // Write to a temporary file, then rename it so that concurrent runs never
+  // read a partially written file
+  std::string hitPath = getHitPath( queryHash, subjHash );
+  std::string tmpPath = hitPath + ".tmp" + std::to_string( getpid() );
+  std::ofstream ofs( tmpPath.c_str(), std::ios::binary );
+  if ( ofs.fail() || !ofs.is_open() ) return false;
+  ofs.write( header.data(), header.size() );
+  ofs.write( payload.data(), payload.size() );
+  ofs.close();
+  if ( ofs.fail() || rename( tmpPath.c_str(), hitPath.c_str() ) != 0 )
+  {
+    remove( tmpPath.c_str() );
+    return false;
+  }
+  return true;
+}
+
+void BlastCache::putHits(
+  std::string &buf, const std::vector< BlastHit > &hits
+  )
+{
+  // Serialize the hits one field at a time, so no padding is written
+  putValue( buf, uint64_t( hits.size() ) );
+  for ( const auto &hit : hits )
+  {
+    putValue( buf, hit.qSeqIdx );
+    putValue( buf, hit.sSeqIdx );
+    putValue( buf, hit.qStart );
+    putValue( buf, hit.qEnd );
+    putValue( buf, hit.sStart );
+    putValue( buf, hit.sEnd );
+    putValue( buf, hit.length );
+    putValue( buf, hit.pIdent );
+  }
+}
+
+bool BlastCache::getHits(
+  const char* &pos, const char* end, std::vector< BlastHit > &hits
+  )
+{
+  uint64_t nHits;
+  if ( !getValue( pos, end, nHits ) ) return false;
+  hits.resize( nHits );
+  for ( auto &hit : hits )
+  {
+    if ( !getValue( pos, end, hit.qSeqIdx ) ||
+      !getValue( pos, end, hit.sSeqIdx ) || !getValue( pos, end, hit.qStart ) ||
+      !getValue( pos, end, hit.qEnd ) || !getValue( pos, end, hit.sStart ) ||
+      !getValue( pos, end, hit.sEnd ) || !getValue( pos, end, hit.length ) ||
+      !getValue( pos, end, hit.pIdent ) )
+    {
+      hits.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,118 @@
+#include "Hash.h"
+#include "BinaryIO.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------
+// BlastCache
+// Ryan D. Crawford
+// 2020/07/21
+// -----------------------------------------------------------------------------
+// This class is a content addressed cache of blast databases and pairwise
+// blast hits that is shared between runs. Databases are keyed on a hash of
+// the contents of the genome and the version of the aligner. Hits are keyed
+// on the hashes of the query and subject genomes, the version of the
+// aligner and the search parameters, so a pair that was searched in an
+// earlier run is never searched again. Hits are stored by the index of
+// their contigs in the genomes, before any identity filter is applied, in a
+// binary file that is checked against a hash of its contents. If the cache
+// directory is empty the cache is disabled: databases are built in a
+// directory of the run and no hits are stored.
+// -----------------------------------------------------------------------------
+
+#ifndef _BLAST_CACHE_
+#define _BLAST_CACHE_
+
+// A blast hit between contigs of a query and subject genome. Positions are
+// one based, as reported by blastn
+struct BlastHit
+{
+  uint32_t qSeqIdx; // Index of the contig in the query genome
+  uint32_t sSeqIdx; // Index of the contig in the subject genome
+  uint32_t qStart;  // First position of the hit in the query contig
+  uint32_t qEnd;    // Last position of the hit in the query contig
+  uint32_t sStart;  // First position of the hit in the subject contig
+  uint32_t sEnd;    // Last position of the hit in the subject contig
+  uint32_t length;  // Length of the alignment
+  double   pIdent;  // Percent identity of the alignment
+};
+
+class BlastCache
+{
+public:
+
+  // Ctor: takes the cache directory, which is disabled if empty, the
+  // directory used for the databases when the cache is disabled, the
+  // version of the aligner and a description of the search parameters.
+  BlastCache( const std::string &cacheDir, const std::string &runDbDir,
+    const std::string &alignerVersion, const std::string &params );
+
+  // Dtor
+  ~BlastCache()
+  { ; }
+
+  // Returns true if hits are stored between runs
+  bool isEnabled() const;
+
+  // Return the path to the blast database of the genome with the input
+  // hash. "variant" distinguishes databases of the same genome that are
+  // built differently, such as with tagged contig ids
+  std::string getDbPath( const uint64_t genomeHash,
+    const std::string &variant = "" ) const;
+
+  // Returns true if the database at the input path was completed by an
+  // earlier run
+  bool hasDb( const std::string &dbPath ) const;
+
+  // Return the path to build the database at "dbPath" under, which is
+  // unique to this process if the cache is enabled
+  std::string getTmpDbPath( const std::string &dbPath ) const;
+
+  // Move the files of the database built at "tmpPath" to "dbPath" and
+  // record that it is complete. If another run completed the database
+  // first its files are kept and the new files are removed. Returns false
+  // if the files could not be moved
+  bool commitDb( const std::string &tmpPath, const std::string &dbPath ) const;
+
+  // Read the hits of the query genome against the subject genome. Returns
+  // false if they are not cached or the cache file is corrupt
+  bool readHits( const uint64_t queryHash, const uint64_t subjHash,
+    std::vector< BlastHit > &hits ) const;
+
+  // Store the hits of the query genome against the subject genome. Returns
+  // false if the cache is disabled or the file could not be written
+  bool writeHits( const uint64_t queryHash, const uint64_t subjHash,
+    const std::vector< BlastHit > &hits ) const;
+
+  // Append the hits to a binary buffer
+  static void putHits( std::string &buf, const std::vector< BlastHit > &hits );
+
+  // Read hits written by "putHits" and advance the position in the buffer.
+  // Returns false if the buffer is too short
+  static bool getHits( const char* &pos, const char* end,
+    std::vector< BlastHit > &hits );
+
+private:
+
+  // Directory with the blast databases
+  std::string dbDir;
+
+  // Directory with the hits for the version and parameters of this run.
+  // Empty if the cache is disabled
+  std::string hitDir;
+
+  // Identifies the format of the hit files
+  static constexpr char hitMagic[9] = "PEARLBH1";
+
+  // Return the path to the file with the hits of a pair of genomes
+  std::string getHitPath( const uint64_t queryHash,
+    const uint64_t subjHash ) const;
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -19,19 +19,37 @@ bool operator >>( BlastResults &blastResults, BlastAlignment &algn );
 // ---- BlastData member functions ---------------------------------------------
 
 BlastData::BlastData(
-  const GenomeData &genomeData,
+  GenomeData       &genomeData,
   const            std::string &outDir,
   const            double &minIdent,
-  const unsigned   int minLen
-  )
+  const unsigned   int minLen,
+  const unsigned   int nThreads,
+  const bool           keepTsv,
+  const bool           isBatched,
+  const bool           isGreedy,
+  const size_t         chunkSize,
+  const size_t         chunkOverlap,
+  const std::string    &blastCacheDir,
+  const std::string    &workDir,
+  Aligner              &aligner
+  ): tsvDir( outDir + "blast_results/" ), keepTsv( keepTsv ),
+  isBatched( isBatched && aligner.canCombine() ), aligner( &aligner ),
+  nThreads( nThreads )
 {
+  // Subjects can only be searched together if the aligner can combine
+  // their indexes
+  if ( isBatched && !this->isBatched )
+  {
+    std::cout << "Warning: the aligner can not search several subjects at "
+              << "once. Each pair of genomes is searched instead" << std::endl;
+  }
+
   // Get the number of genomes in this dataset
   unsigned int nGenomes = genomeData.getNumGenomes();
 
   // Make the paths to the blast databases and to the directory to store the
   // reslts
-  std::string dbDir  = outDir + "blast_dbs/";
-  std::string tsvDir = outDir + "blast_results/";
+  std::string dbDir = outDir + "blast_dbs/";
 
   if ( !fs::exists( dbDir ) )
   {
@@ -39,94 +57,1565 @@ BlastData::BlastData(
     system( cmd.c_str() );
   }
 
-  if ( !fs::exists( tsvDir ) )
+  if ( keepTsv && !fs::exists( tsvDir ) )
   {
     auto cmd = "mkdir " + tsvDir;
     system( cmd.c_str() );
   }
 
-  // Make blast databases
-  std::vector< std::string > blastDbs( nGenomes );
-  for ( unsigned int i = 1; i < nGenomes; i++ )
-    blastDbs[i] = madeBlastDb( genomeData.getGenomeRefAtIdx( i ), dbDir );
+  ThreadPool pool( nThreads );
+
+  if ( isGreedy )
+  {
+    // Each genome is searched against the regions added by the genomes
+    // before it, so the searches can not be queued up front
+    if ( !workDir.empty() )
+      std::cout << "Warning: the searches of the greedy mode are not queued "
+                << "in the work directory" << std::endl;
+    alignPanGenome( genomeData, minIdent, minLen, dbDir, chunkSize,
+      chunkOverlap, pool );
+    finishResults( genomeData );
+    this->aligner = nullptr;
+    return;
+  }
+
+  // Hits depend on the version of the aligner, its parameters, whether the
+  // subjects are searched together, which changes the statistics of the
+  // hits, and the windows of the queries, whose hits are joined at the
+  // seams. If the version is unknown nothing is cached
+  std::string version;
+  if ( !blastCacheDir.empty() )
+  {
+    version = aligner.getVersion();
+    if ( version.empty() )
+      std::cout << "Warning: unable to get the version of the aligner. The "
+                << "alignments will not be cached" << std::endl;
+  }
+  // The masks change both the hits and the indexes, so they are part of
+  // the parameters and of the names of the cached indexes
+  std::string maskTag = genomeData.isMasked() ?
+    "mask" + std::to_string( minLen ) : "";
+  std::string params = getSearchParams( genomeData, minLen, false );
+  if ( chunkSize > 0 )
+    params += " chunk" + std::to_string( chunkSize ) + "_" +
+      std::to_string( chunkOverlap );
+  BlastCache cache( version.empty() ? "" : blastCacheDir, dbDir, version,
+    params );
+
+  // Hash the contents of the genomes, which identify their databases and
+  // hits in the cache, and the genomes of the queued searches. Otherwise
+  // the genomes are not read to hash them, and are identified by their
+  // index instead
+  genomeHashes.resize( nGenomes );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    if ( !cache.isEnabled() && workDir.empty() )
+    {
+      genomeHashes[i] = i;
+      continue;
+    }
+    pool.addJob( [this, i, &genomeData]()
+      { genomeHashes[i] = genomeData.getGenomeRefAtIdx( i )->hashSeqs(); } );
+  }
+  pool.wait();
+
+  // The hits of pairs that include a duplicate genome are copied from the
+  // hits of the genomes they duplicate, so these pairs are not searched.
+  // The hits of query i against subject j are at index j - i - 1
+  std::vector< std::vector< char > > isDerived( nGenomes );
+  unsigned int nDerived = 0;
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    isDerived[i].assign( nGenomes - i - 1, false );
+    for ( unsigned int j = i + 1; j < nGenomes; j++ )
+    {
+      isDerived[i][ j - i - 1 ] = genomeData.getDuplicateOf( i ) != i ||
+        genomeData.getDuplicateOf( j ) != j;
+      nDerived += isDerived[i][ j - i - 1 ];
+    }
+  }
+
+  // If the genomes were sketched, pairs that share no hashes are skipped,
+  // since they are unlikely to share an alignment
+  std::vector< std::vector< char > > isSkipped( nGenomes );
+  unsigned int nPairs   = nGenomes * ( nGenomes - 1 ) / 2;
+  unsigned int nSkipped = 0;
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    isSkipped[i].assign( nGenomes - i - 1, false );
+    if ( !genomeData.isSketched() ) continue;
+    for ( unsigned int j = i + 1; j < nGenomes; j++ )
+    {
+      if ( isDerived[i][ j - i - 1 ] ) continue;
+      isSkipped[i][ j - i - 1 ] = genomeData.getNumShared( i, j ) == 0;
+      nSkipped += isSkipped[i][ j - i - 1 ];
+    }
+  }
+
+  // Hits are cached under the hashes of the query and the subject. In
+  // batched mode the statistics of the hits depend on every subject in the
+  // combined database, so the query is identified by its hash and the
+  // hashes of all of its subjects, and its hits are only reused if every
+  // subject was cached
+  std::vector< uint64_t > queryKeys( genomeHashes );
+  if ( this->isBatched )
+  {
+    for ( unsigned int i = 0; i < nGenomes; i++ )
+    {
+      std::vector< uint64_t > subjHashes;
+      for ( unsigned int j = i + 1; j < nGenomes; j++ )
+        if ( !isDerived[i][ j - i - 1 ] && !isSkipped[i][ j - i - 1 ] )
+          subjHashes.push_back( genomeHashes[j] );
+      std::sort( subjHashes.begin(), subjHashes.end() );
+      queryKeys[i] = hashBytes( subjHashes.data(),
+        subjHashes.size() * sizeof( uint64_t ), genomeHashes[i] );
+    }
+  }
+
+  // Read the hits of the pairs that were searched by earlier runs
+  std::vector< std::vector< std::vector< BlastHit > > > pairHits( nGenomes );
+  std::vector< std::vector< char > >                    isCached( nGenomes );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    pairHits[i].resize( nGenomes - i - 1 );
+    isCached[i].assign( nGenomes - i - 1, false );
+    if ( !cache.isEnabled() ) continue;
+    pool.addJob( [&, i]()
+      {
+        bool isAllCached = true;
+        for ( unsigned int j = i + 1; j < nGenomes; j++ )
+        {
+          if ( isDerived[i][ j - i - 1 ] || isSkipped[i][ j - i - 1 ] )
+            continue;
+          isCached[i][ j - i - 1 ] = cache.readHits( queryKeys[i],
+            genomeHashes[j], pairHits[i][ j - i - 1 ] );
+          isAllCached = isAllCached && isCached[i][ j - i - 1 ];
+        }
+        if ( !this->isBatched || isAllCached ) return;
+        for ( unsigned int j = i + 1; j < nGenomes; j++ )
+        {
+          isCached[i][ j - i - 1 ] = false;
+          std::vector< BlastHit >().swap( pairHits[i][ j - i - 1 ] );
+        }
+      } );
+  }
+  pool.wait();
+
+  // Find the subjects that each query still needs to be blasted against
+  std::vector< std::vector< unsigned int > > querySubjs( nGenomes );
+  unsigned int nCached = 0;
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    for ( unsigned int j = i + 1; j < nGenomes; j++ )
+    {
+      if ( isDerived[i][ j - i - 1 ] || isSkipped[i][ j - i - 1 ] ) continue;
+      if ( isCached[i][ j - i - 1 ] ) nCached++;
+      else querySubjs[i].push_back( j );
+    }
+  }
+  if ( cache.isEnabled() )
+  {
+    std::cout << "Reusing cached blast results for " << nCached << " of "
+              << nPairs << " pairs of genomes" << std::endl;
+  }
+  if ( nDerived > 0 )
+  {
+    std::cout << "Copying the hits of " << nDerived << " of " << nPairs
+              << " pairs of genomes from the genomes they duplicate"
+              << std::endl;
+  }
+  if ( genomeData.isSketched() )
+  {
+    std::cout << "Skipping " << nSkipped << " of " << nPairs << " pairs of "
+              << "genomes that share no sketch hashes" << std::endl;
+  }
+
+  // Index the subjects that are still searched, starting with the largest
+  // genomes. Genomes with the same contents share an index, and indexes are
+  // only built once if the cache is enabled. In batched mode the contigs
+  // are tagged with the hash of their genome and their index, so that hits
+  // against the combined indexes can be assigned to their genome
+  std::vector< std::string >  blastDbs( nGenomes );
+  std::vector< unsigned int > dbOrder;
+  std::set< std::string >     dbPaths;
+  for ( unsigned int j = 1; j < nGenomes; j++ )
+  {
+    blastDbs[j] = cache.getDbPath( genomeHashes[j],
+      ( this->isBatched ? "tagged" : "" ) + maskTag );
+    bool isNeeded = false;
+    for ( unsigned int i = 0; i < j; i++ )
+      if ( !isCached[i][ j - i - 1 ] && !isSkipped[i][ j - i - 1 ] &&
+        !isDerived[i][ j - i - 1 ] )
+      {
+        isNeeded = true;
+      }
+    if ( isNeeded && !cache.hasDb( blastDbs[j] ) &&
+      dbPaths.insert( blastDbs[j] ).second )
+    {
+      dbOrder.push_back( j );
+    }
+  }
+  std::stable_sort( dbOrder.begin(), dbOrder.end(),
+    [&genomeData]( const unsigned int lhs, const unsigned int rhs )
+    {
+      return genomeData.getGenomeRefAtIdx( lhs )->getGenomeSize() >
+        genomeData.getGenomeRefAtIdx( rhs )->getGenomeSize();
+    } );
+  for ( auto j : dbOrder )
+  {
+    const Genome* genome = genomeData.getGenomeRefAtIdx( j );
+    std::string   tag    = this->isBatched ? getGenomeTag( j ) : "";
+    pool.addJob( [this, j, genome, tag, &blastDbs, &cache]()
+      {
+        // The index is built under a temporary name, so that other runs
+        // sharing the cache never search it while it is being built
+        std::string tmpPath = cache.getTmpDbPath( blastDbs[j] );
+        if ( !this->aligner->buildIndex( genome, tmpPath, tag ) ||
+          !cache.commitDb( tmpPath, blastDbs[j] ) )
+        {
+          std::cout << "Warning: unable to index "
+                    << genome->getGenomeName() << std::endl;
+        }
+      } );
+  }
+  pool.wait();
+
+  // In batched mode each query is searched against an index that combines
+  // the indexes of its subjects
+  std::vector< std::string > aliases( nGenomes );
+  if ( this->isBatched )
+  {
+    for ( unsigned int i = 0; i < nGenomes; i++ )
+    {
+      if ( querySubjs[i].empty() ) continue;
+      std::vector< std::string > subjDbs;
+      for ( auto j : querySubjs[i] ) subjDbs.push_back( blastDbs[j] );
+      aliases[i] = dbDir +
+        genomeData.getGenomeRefAtIdx( i )->getGenomeName() + "_subjects";
+      if ( !aligner.combineIndexes( subjDbs, aliases[i] ) )
+      {
+        std::cout << "Unable to combine the indexes of the subjects of "
+                  << genomeData.getGenomeRefAtIdx( i )->getGenomeName()
+                  << std::endl;
+        exit( 1 );
+      }
+    }
+  }
+
+  // Queries are split into windows that are searched as separate jobs if
+  // requested. Windows are never chosen from the number of threads, so the
+  // hits do not depend on it
+  std::vector< std::vector< QueryChunk > > queryChunks( nGenomes );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    if ( querySubjs[i].empty() ) continue;
+    const Genome* query = genomeData.getGenomeRefAtIdx( i );
+    queryChunks[i] = splitMaskedQuery( query, chunkSize, chunkOverlap );
+  }
 
-  // Blast each pair of genomes.
+  // The cost of a search is estimated as the product of the sizes of the
+  // query and the subjects, and the most expensive searches are started
+  // first so that the last jobs to finish are short
+  std::vector< BlastJob >                    jobs;
+  std::vector< std::vector< unsigned int > > queryJobs( nGenomes );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    // Masked queries are always searched in windows, so a masked query
+    // without windows has nothing left to search
+    if ( querySubjs[i].empty() ) continue;
+    if ( queryChunks[i].empty() &&
+      genomeData.getGenomeRefAtIdx( i )->isMasked() )
+    {
+      continue;
+    }
+    int nChunks = queryChunks[i].size();
+    for ( int c = nChunks > 0 ? 0 : -1; c < nChunks; c++ )
+    {
+      double qSize = 0;
+      if ( c < 0 ) qSize = genomeData.getGenomeRefAtIdx( i )->getGenomeSize();
+      else for ( const auto &seg : queryChunks[i][c] ) qSize += seg.len;
+      if ( this->isBatched )
+      {
+        double sSize = 0;
+        for ( auto j : querySubjs[i] )
+          sSize += genomeData.getGenomeRefAtIdx( j )->getGenomeSize();
+        queryJobs[i].push_back( jobs.size() );
+        jobs.push_back( { i, c, querySubjs[i], qSize * sSize } );
+        continue;
+      }
+      for ( auto j : querySubjs[i] )
+      {
+        queryJobs[i].push_back( jobs.size() );
+        jobs.push_back( { i, c, { j },
+          qSize * genomeData.getGenomeRefAtIdx( j )->getGenomeSize() } );
+      }
+    }
+  }
+  std::vector< unsigned int > jobOrder( jobs.size() );
+  for ( unsigned int k = 0; k < jobs.size(); k++ ) jobOrder[k] = k;
+  std::stable_sort( jobOrder.begin(), jobOrder.end(),
+    [&jobs]( const unsigned int lhs, const unsigned int rhs )
+    { return jobs[ lhs ].cost > jobs[ rhs ].cost; } );
+
+  // The hits of each job are parsed into their own vectors, one for each
+  // subject, so the order the jobs finish in does not matter. The number of
+  // searches left for each genome and each index is counted so its
+  // sequences and index can be released. Genomes with no searches left are
+  // released now. In batched mode a job searches the combined index of its
+  // query, which holds the indexes of its subjects
+  std::vector< std::vector< std::vector< BlastHit > > > jobHits( jobs.size() );
+  std::vector< char >         isJobDone( jobs.size(), false );
+  std::vector< unsigned int > nJobsLeft( nGenomes, 0 );
+  std::unordered_map< std::string, unsigned int > nIdxJobsLeft;
+  auto getJobIndexes = [&]( const BlastJob &job )
+    {
+      std::vector< std::string > idxPaths;
+      if ( this->isBatched ) idxPaths.push_back( aliases[ job.query ] );
+      for ( auto j : job.subjects ) idxPaths.push_back( blastDbs[j] );
+      return idxPaths;
+    };
+  for ( unsigned int k = 0; k < jobs.size(); k++ )
+  {
+    jobHits[k].resize( jobs[k].subjects.size() );
+    for ( auto j : jobs[k].subjects )
+    {
+      nJobsLeft[ jobs[k].query ]++;
+      nJobsLeft[j]++;
+    }
+    for ( const auto &idxPath : getJobIndexes( jobs[k] ) )
+      nIdxJobsLeft[ idxPath ]++;
+  }
+  for ( unsigned int g = 0; g < nGenomes; g++ )
+    if ( nJobsLeft[g] == 0 ) genomeData.releaseGenome( g );
+
+  // If the searches are distributed, the jobs are queued in the order they
+  // would be started here, and the hits of each job are read back from its
+  // shard once every job is finished
+  if ( !workDir.empty() )
+  {
+    std::vector< std::string > queued;
+    for ( auto k : jobOrder )
+    {
+      const BlastJob   &job   = jobs[k];
+      const QueryChunk* chunk = job.chunk < 0 ? nullptr :
+        &queryChunks[ job.query ][ job.chunk ];
+      queued.push_back( encodeJob( job, chunk, this->isBatched ?
+        aliases[ job.query ] : blastDbs[ job.subjects[0] ] ) );
+    }
+    WorkQueue queue( workDir );
+    if ( !queue.create( getSearchParams( genomeData, minLen, true ),
+      queued ) )
+    {
+      std::cout << "Unable to queue the searches in " << workDir << std::endl;
+      exit( 1 );
+    }
+    runQueue( queue, genomeData, pool, true );
+    for ( unsigned int r = 0; r < jobOrder.size(); r++ )
+    {
+      unsigned int k = jobOrder[r];
+      std::string  shard;
+      uint8_t      isOk   = 0;
+      bool         isRead = queue.readShard( r, shard );
+      const char*  pos    = shard.data();
+      const char*  end    = shard.data() + shard.size();
+      // Jobs that could not be read by a worker have an empty shard
+      if ( isRead && shard.empty() )
+      {
+        std::cout << "Warning: job " << r << " could not be read by the "
+                  << "workers" << std::endl;
+        continue;
+      }
+      isRead = isRead && getValue( pos, end, isOk );
+      for ( auto &hits : jobHits[k] )
+        isRead = isRead && BlastCache::getHits( pos, end, hits );
+      if ( !isRead )
+        std::cout << "Warning: the shard of job " << r << " is corrupt"
+                  << std::endl;
+      isJobDone[k] = isRead && isOk;
+    }
+  } else {
+    std::mutex jobsMutex;
+    for ( auto k : jobOrder )
+    {
+      pool.addJob( [&, k]()
+        {
+          const BlastJob   &job   = jobs[k];
+          const Genome*    query = genomeData.getGenomeRefAtIdx( job.query );
+          const QueryChunk* chunk = job.chunk < 0 ? nullptr :
+            &queryChunks[ job.query ][ job.chunk ];
+          if ( this->isBatched )
+          {
+            isJobDone[k] = blastBatch( query, chunk, genomeData, job.subjects,
+              aliases[ job.query ], jobHits[k].data() );
+          } else {
+            unsigned int j = job.subjects[0];
+            isJobDone[k] = blastFasta( query, chunk,
+              genomeData.getGenomeRefAtIdx( j ), blastDbs[j], jobHits[k][0] );
+          }
+
+          // Release the sequences of the genomes, and the indexes, that
+          // are finished
+          std::vector< unsigned int > finished;
+          std::vector< std::string >  finishedIdxs;
+          {
+            std::lock_guard< std::mutex > lock( jobsMutex );
+            for ( auto j : job.subjects )
+            {
+              if ( --nJobsLeft[ job.query ] == 0 )
+                finished.push_back( job.query );
+              if ( --nJobsLeft[j] == 0 ) finished.push_back( j );
+            }
+            for ( const auto &idxPath : getJobIndexes( job ) )
+              if ( --nIdxJobsLeft[ idxPath ] == 0 )
+                finishedIdxs.push_back( idxPath );
+          }
+          for ( auto g : finished ) genomeData.releaseGenome( g );
+          for ( const auto &idxPath : finishedIdxs )
+            this->aligner->releaseIndex( idxPath );
+        } );
+    }
+    pool.wait();
+  }
+
+  // Gather the hits of each pair from the windows of the query, in order,
+  // and cache the pairs whose searches all succeeded
+  for ( unsigned int i = 0; i < nGenomes - 1; i++ )
+  {
+    for ( unsigned int j = i + 1; j < nGenomes; j++ )
+    {
+      std::vector< BlastHit > &hits = pairHits[i][ j - i - 1 ];
+      if ( isCached[i][ j - i - 1 ] || isSkipped[i][ j - i - 1 ] ||
+        isDerived[i][ j - i - 1 ] )
+      {
+        continue;
+      }
+      bool isDone = true;
+      for ( auto k : queryJobs[i] )
+      {
+        const auto &subjs = jobs[k].subjects;
+        auto        it    = std::lower_bound( subjs.begin(), subjs.end(), j );
+        if ( it == subjs.end() || *it != j ) continue;
+        auto &kHits = jobHits[k][ it - subjs.begin() ];
+        hits.insert( hits.end(), kHits.begin(), kHits.end() );
+        std::vector< BlastHit >().swap( kHits );
+        isDone = isDone && isJobDone[k];
+      }
+      if ( chunkSize > 0 )
+      {
+        joinWindowHits( hits, genomeData.getGenomeRefAtIdx( i ),
+          genomeData.getGenomeRefAtIdx( j ) );
+      }
+      if ( isDone ) cache.writeHits( queryKeys[i], genomeHashes[j], hits );
+    }
+  }
+
+  // The hits of every pair are then parsed in the order of the subjects,
+  // so the results are the same whether or not they were cached, and
+  // whatever order the searches finished in
   blastResults.reserve( nGenomes - 1 );
-  const Genome* query;
-  const Genome* subject;
-  for ( unsigned int i = 0; i < nGenomes - 1; i ++ )
+  for ( unsigned int i = 0; i < nGenomes - 1; i++ )
   {
-    // Create a "blast results" class object and add it to the vector
+    const Genome* query = genomeData.getGenomeRefAtIdx( i );
     blastResults.push_back( BlastResults( minIdent, minLen ) );
+    for ( unsigned int j = i + 1; j < nGenomes; j++ )
+    {
+      const Genome*           subject = genomeData.getGenomeRefAtIdx( j );
+      std::vector< BlastHit > derived;
+      if ( isDerived[i][ j - i - 1 ] )
+        deriveHits( genomeData, i, j, pairHits, derived );
+      const auto &hits = isDerived[i][ j - i - 1 ] ? derived :
+        pairHits[i][ j - i - 1 ];
+      for ( const auto &hit : hits )
+        blastResults[i].addHit( hit, query, subject );
+    }
+  }
+  pairHits.clear();
 
-    // Get the reference to the query
-    query = genomeData.getGenomeRefAtIdx( i );
+  finishResults( genomeData );
+  this->aligner = nullptr;
+}
 
-    // Blast the next set of genomes
-    for ( unsigned int j = i + 1; j < nGenomes; j++ )
+BlastData::BlastData(
+  GenomeData         &genomeData,
+  const std::string  &workDir,
+  const unsigned int minLen,
+  const unsigned int nThreads,
+  const bool         isBatched,
+  Aligner            &aligner
+  ): keepTsv( false ), isBatched( isBatched && aligner.canCombine() ),
+  aligner( &aligner ), nThreads( nThreads )
+{
+  unsigned int nGenomes = genomeData.getNumGenomes();
+  ThreadPool   pool( nThreads );
+
+  // The jobs name the genomes by the hashes of their contents
+  genomeHashes.resize( nGenomes );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    pool.addJob( [this, i, &genomeData]()
+      { genomeHashes[i] = genomeData.getGenomeRefAtIdx( i )->hashSeqs(); } );
+  }
+  pool.wait();
+
+  WorkQueue queue( workDir );
+  if ( !queue.open( getSearchParams( genomeData, minLen, true ) ) )
+  {
+    std::cout << "Unable to join the searches queued in " << workDir
+              << std::endl;
+    exit( 1 );
+  }
+  std::cout << "Running the searches of the " << queue.getNumJobs()
+            << " jobs queued in " << workDir << std::endl;
+  runQueue( queue, genomeData, pool, false );
+  this->aligner = nullptr;
+}
+
+std::string BlastData::getSearchParams(
+  const GenomeData &genomeData, const unsigned int minLen,
+  const bool isQueued
+  ) const
+{
+  std::string params = aligner->getParams() + ( isBatched ? " batch" : "" );
+  if ( genomeData.isMasked() ) params += " mask" + std::to_string( minLen );
+  if ( !isQueued ) return params;
+
+  // The genomes are hashed in sorted order, since the coordinator and the
+  // workers may order them differently
+  std::vector< uint64_t > hashes( genomeHashes );
+  std::sort( hashes.begin(), hashes.end() );
+  uint64_t genomesHash = hashBytes( hashes.data(),
+    hashes.size() * sizeof( uint64_t ) );
+  return aligner->getVersion() + " " + params + " genomes " +
+    hashToHex( genomesHash );
+}
+
+std::string BlastData::encodeJob(
+  const BlastJob &job, const QueryChunk* chunk, const std::string &idxPath
+  ) const
+{
+  std::string buf;
+  putValue( buf, genomeHashes[ job.query ] );
+  putValue( buf, uint32_t( chunk == nullptr ? 0 : chunk->size() ) );
+  if ( chunk != nullptr )
+  {
+    for ( const auto &seg : *chunk )
+    {
+      putValue( buf, uint32_t( seg.seqIdx ) );
+      putValue( buf, uint64_t( seg.startPos ) );
+      putValue( buf, uint64_t( seg.len ) );
+      putValue( buf, uint64_t( seg.coreStart ) );
+      putValue( buf, uint64_t( seg.coreLen ) );
+    }
+  }
+  putString( buf, fs::absolute( idxPath ).string() );
+  putValue( buf, uint32_t( job.subjects.size() ) );
+  for ( auto j : job.subjects ) putValue( buf, genomeHashes[j] );
+  return buf;
+}
+
+void BlastData::runQueuedJob(
+  const GenomeData                                   &genomeData,
+  const std::unordered_map< uint64_t, unsigned int > &hashIdxs,
+  const std::string                                  &job,
+  std::string                                        &shard
+  )
+{
+  const char* pos = job.data();
+  const char* end = job.data() + job.size();
+
+  // Find the genomes of the job from their hashes
+  auto findGenome = [&]( unsigned int &idx )
+    {
+      uint64_t hash;
+      if ( !getValue( pos, end, hash ) ) return false;
+      auto it = hashIdxs.find( hash );
+      if ( it == hashIdxs.end() )
+      {
+        std::cout << "The genome " << hashToHex( hash ) << " of a queued job "
+                  << "is not one of the input genomes" << std::endl;
+        exit( 1 );
+      }
+      idx = it->second;
+      return true;
+    };
+
+  unsigned int                query;
+  uint32_t                    nSegs;
+  QueryChunk                  chunk;
+  std::string                 idxPath;
+  uint32_t                    nSubjs;
+  std::vector< unsigned int > subjects;
+  bool isRead = findGenome( query ) && getValue( pos, end, nSegs );
+  for ( uint32_t i = 0; isRead && i < nSegs; i++ )
+  {
+    uint32_t seqIdx;
+    uint64_t startPos, len, coreStart, coreLen;
+    isRead = getValue( pos, end, seqIdx ) && getValue( pos, end, startPos ) &&
+      getValue( pos, end, len ) && getValue( pos, end, coreStart ) &&
+      getValue( pos, end, coreLen );
+    if ( isRead )
+      chunk.push_back( { seqIdx, startPos, len, coreStart, coreLen } );
+  }
+  isRead = isRead && getString( pos, end, idxPath ) &&
+    getValue( pos, end, nSubjs ) && nSubjs > 0;
+  subjects.resize( isRead ? nSubjs : 0 );
+  for ( auto &j : subjects ) isRead = isRead && findGenome( j );
+  if ( !isRead )
+  {
+    std::cout << "Unable to read a queued job" << std::endl;
+    exit( 1 );
+  }
+
+  // A window with no pieces is the whole query
+  const Genome*     genome = genomeData.getGenomeRefAtIdx( query );
+  const QueryChunk* window = chunk.empty() ? nullptr : &chunk;
+  std::vector< std::vector< BlastHit > > hits( subjects.size() );
+  bool isDone;
+  if ( this->isBatched )
+  {
+    isDone = blastBatch( genome, window, genomeData, subjects, idxPath,
+      hits.data() );
+  } else {
+    isDone = blastFasta( genome, window,
+      genomeData.getGenomeRefAtIdx( subjects[0] ), idxPath, hits[0] );
+  }
+
+  shard.clear();
+  putValue( shard, uint8_t( isDone ) );
+  for ( const auto &subjHits : hits ) BlastCache::putHits( shard, subjHits );
+}
+
+void BlastData::runQueue(
+  WorkQueue        &queue,
+  const GenomeData &genomeData,
+  ThreadPool       &pool,
+  const bool       isCoordinator
+  )
+{
+  // Genomes with the same contents have the same hits, so the first genome
+  // with each hash is searched
+  std::unordered_map< uint64_t, unsigned int > hashIdxs;
+  for ( unsigned int i = 0; i < genomeHashes.size(); i++ )
+    hashIdxs.emplace( genomeHashes[i], i );
+
+  // The claims are touched, and stale claims returned to the queue, on a
+  // separate thread while the jobs run
+  std::atomic< bool > isFinished( false );
+  std::thread monitor( [&]()
+    {
+      const auto step     = std::chrono::milliseconds( 100 );
+      auto       lastTouch = std::chrono::steady_clock::now();
+      auto       lastCheck = lastTouch;
+      while ( !isFinished )
+      {
+        std::this_thread::sleep_for( step );
+        auto now = std::chrono::steady_clock::now();
+        if ( now - lastTouch >= std::chrono::seconds( WorkQueue::touchSecs ) )
+        {
+          queue.touchClaims();
+          lastTouch = now;
+        }
+        if ( isCoordinator &&
+          now - lastCheck >= std::chrono::seconds( WorkQueue::pollSecs ) )
+        {
+          queue.requeueStale();
+          lastCheck = now;
+        }
+      }
+    } );
+
+  // Each thread claims jobs until the queue is empty. Jobs claimed by other
+  // processes may be returned to the queue, so it is checked until every
+  // job has a shard
+  unsigned int nRun = 0;
+  std::mutex   runMutex;
+  while ( !queue.isComplete() )
+  {
+    for ( unsigned int t = 0; t < pool.getNumThreads(); t++ )
+    {
+      pool.addJob( [&]()
+        {
+          unsigned int jobId;
+          std::string  job;
+          std::string  shard;
+          while ( queue.claimJob( jobId, job ) )
+          {
+            runQueuedJob( genomeData, hashIdxs, job, shard );
+            if ( !queue.writeShard( jobId, shard ) )
+            {
+              std::cout << "Unable to write the shard of job " << jobId
+                        << std::endl;
+              exit( 1 );
+            }
+            std::lock_guard< std::mutex > lock( runMutex );
+            nRun++;
+          }
+        } );
+    }
+    pool.wait();
+    if ( !queue.isComplete() )
+    {
+      std::this_thread::sleep_for(
+        std::chrono::seconds( WorkQueue::pollSecs ) );
+    }
+  }
+  isFinished = true;
+  monitor.join();
+  std::cout << "Ran " << nRun << " of the " << queue.getNumJobs()
+            << " queued jobs" << std::endl;
+}
+
+void BlastData::alignPanGenome(
+  GenomeData        &genomeData,
+  const double      &minIdent,
+  const unsigned    int minLen,
+  const std::string &dbDir,
+  const size_t      chunkSize,
+  const size_t      chunkOverlap,
+  ThreadPool        &pool
+  )
+{
+  unsigned int nGenomes = genomeData.getNumGenomes();
+
+  // The regions each genome added to the pan-genome, and their index. A
+  // genome whose regions were not indexed has no index path
+  std::vector< std::vector< SeqRange > > panRanges( nGenomes );
+  std::vector< std::string >             panIdxs( nGenomes );
+  size_t                                 panSize = 0;
+
+  blastResults.reserve( nGenomes - 1 );
+  for ( unsigned int i = 0; i < nGenomes - 1; i++ )
+    blastResults.push_back( BlastResults( minIdent, minLen ) );
+
+  for ( unsigned int k = 0; k < nGenomes; k++ )
+  {
+    const Genome* genome = genomeData.getGenomeRefAtIdx( k );
+
+    // Find the earlier genomes with regions in the pan-genome. If the
+    // genomes were sketched, those that share no hashes with this genome
+    // are skipped
+    std::vector< unsigned int > sources;
+    std::vector< int >          srcPos( k, -1 );
+    for ( unsigned int h = 0; h < k; h++ )
+    {
+      if ( panIdxs[h].empty() ) continue;
+      if ( genomeData.isSketched() && genomeData.getNumShared( h, k ) == 0 )
+        continue;
+      srcPos[h] = sources.size();
+      sources.push_back( h );
+    }
+
+    // Search the indexes of the sources as one index if the aligner can
+    // combine them, otherwise one at a time
+    std::vector< std::string > targets;
+    std::vector< uint32_t >    targetSeqs;
+    std::string                combined;
+    if ( sources.size() > 1 && aligner->canCombine() )
     {
-      subject =  genomeData.getGenomeRefAtIdx( j );
-      std::string tsv =
-        blastFasta( query, subject, blastDbs[j], tsvDir );
-      blastResults[i].parseBlastData( tsv, query, subject );
+      std::vector< std::string > idxPaths;
+      uint32_t                   nSeqs = 0;
+      for ( auto h : sources )
+      {
+        idxPaths.push_back( panIdxs[h] );
+        nSeqs += panRanges[h].size();
+      }
+      combined = dbDir + genome->getGenomeName() + "_pangenome";
+      if ( !aligner->combineIndexes( idxPaths, combined ) )
+      {
+        std::cout << "Unable to combine the indexes of the pan-genome for "
+                  << genome->getGenomeName() << std::endl;
+        exit( 1 );
+      }
+      targets.push_back( combined );
+      targetSeqs.push_back( nSeqs );
+    } else {
+      for ( auto h : sources )
+      {
+        targets.push_back( panIdxs[h] );
+        targetSeqs.push_back( panRanges[h].size() );
+      }
+    }
+
+    // The genome is split into windows if requested
+    std::vector< QueryChunk > chunks;
+    if ( !targets.empty() )
+      chunks = splitMaskedQuery( genome, chunkSize, chunkOverlap );
+
+    // Each search parses its hits into its own vectors, one for each
+    // source, so the order the searches finish in does not matter. A
+    // masked genome without windows has nothing to search
+    int nChunks = chunks.size();
+    int nJobs   = targets.size() * std::max( nChunks, 1 );
+    if ( nChunks == 0 && genome->isMasked() ) nJobs = 0;
+    std::vector< std::vector< std::vector< BlastHit > > > jobHits( nJobs );
+    for ( int j = 0; j < nJobs; j++ )
+    {
+      jobHits[j].resize( sources.size() );
+      pool.addJob( [&, j]()
+        {
+          unsigned int      t     = j / std::max( nChunks, 1 );
+          const QueryChunk* chunk = nChunks == 0 ? nullptr :
+            &chunks[ j % nChunks ];
+          runSearch( genome, chunk, targets[t], "pangenome", targetSeqs[t],
+            [&]( AlignRecord &rec )
+            {
+              unsigned int h;
+              BlastHit     hit;
+              if ( !parsePanHit( rec, genome, panRanges, h, hit ) ) return;
+              if ( h < k && srcPos[h] >= 0 )
+                jobHits[j][ srcPos[h] ].push_back( hit );
+            } );
+        } );
+    }
+    pool.wait();
+    if ( !combined.empty() ) aligner->releaseIndex( combined );
+
+    // Parse the hits of each source in the order of the searches, and find
+    // the regions of the genome they cover. Hits that were cut at the seams
+    // of the windows are joined first, so they cover the whole region. Only
+    // hits that would be kept as alignments cover the genome, so short hits
+    // do not split a novel region into pieces that are too short to add
+    std::vector< std::vector< std::pair< size_t, size_t > > > covered(
+      genome->getNumContigs() );
+    for ( unsigned int p = 0; p < sources.size(); p++ )
+    {
+      const Genome* source = genomeData.getGenomeRefAtIdx( sources[p] );
+      std::vector< BlastHit > hits;
+      for ( auto &jHits : jobHits )
+      {
+        hits.insert( hits.end(), jHits[p].begin(), jHits[p].end() );
+        std::vector< BlastHit >().swap( jHits[p] );
+      }
+      if ( chunkSize > 0 ) joinWindowHits( hits, source, genome );
+      for ( const auto &hit : hits )
+      {
+        blastResults[ sources[p] ].addHit( hit, source, genome );
+        if ( hit.pIdent < minIdent || hit.length < minLen ) continue;
+        covered[ hit.sSeqIdx ].push_back( {
+          std::min( hit.sStart, hit.sEnd ) - 1,
+          std::max( hit.sStart, hit.sEnd ) } );
+      }
+    }
+
+    // The regions that are not covered by a hit, and are long enough to
+    // hold an alignment, are new to the pan-genome. Regions that are
+    // excluded by the masks are treated as covered
+    size_t nNovel = 0;
+    for ( unsigned int i = 0; i < genome->getNumContigs(); i++ )
+    {
+      auto   &ivals    = covered[i];
+      size_t searchEnd = 0;
+      for ( const auto &region : genome->getSearchedRegions( i ) )
+      {
+        if ( region.first > searchEnd )
+          ivals.push_back( { searchEnd, region.first } );
+        searchEnd = region.second;
+      }
+      if ( searchEnd < genome->getSeqLen( i ) )
+        ivals.push_back( { searchEnd, genome->getSeqLen( i ) } );
+      std::sort( ivals.begin(), ivals.end() );
+      ivals.push_back( { genome->getSeqLen( i ), genome->getSeqLen( i ) } );
+      size_t pos = 0;
+      for ( const auto &ival : ivals )
+      {
+        if ( ival.first >= pos + minLen )
+        {
+          std::string name = "p" + std::to_string( k ) + "_" +
+            std::to_string( panRanges[k].size() );
+          panRanges[k].push_back( { i, pos, ival.first - pos, name } );
+          nNovel += ival.first - pos;
+        }
+        pos = std::max( pos, ival.second );
+      }
+    }
+    panSize += nNovel;
+    std::cout << "Pan-genome: " << genome->getGenomeName() << " adds "
+              << nNovel << " of " << genome->getGenomeSize() << " nts, "
+              << panSize << " nts in total" << std::endl;
+
+    // Index the new regions, unless no genome is left to search them
+    if ( k + 1 < nGenomes && !panRanges[k].empty() )
+    {
+      std::string idxPath = dbDir + genome->getGenomeName() + "_novel";
+      if ( aligner->indexRanges( genome, panRanges[k], idxPath ) )
+        panIdxs[k] = idxPath;
+      else
+        std::cout << "Warning: unable to index " << genome->getGenomeName()
+                  << std::endl;
+    }
+    genomeData.releaseGenome( k );
+  }
+}
+
+bool BlastData::parsePanHit(
+  const AlignRecord                            &rec,
+  const Genome*                                genome,
+  const std::vector< std::vector< SeqRange > > &panRanges,
+  unsigned int                                 &source,
+  BlastHit                                     &hit
+  ) const
+{
+  // The subject name is the index of the source genome and of its region
+  size_t sep = rec.sName.rfind( '_' );
+  if ( rec.sName.size() < 2 || rec.sName[0] != 'p' ||
+    sep == std::string::npos || sep < 2 )
+  {
+    return false;
+  }
+  unsigned int rangeIdx;
+  if ( !parseIndex( rec.sName.substr( 1, sep - 1 ), source ) ||
+    !parseIndex( rec.sName.substr( sep + 1 ), rangeIdx ) )
+  {
+    return false;
+  }
+  if ( source >= panRanges.size() || rangeIdx >= panRanges[ source ].size() )
+    return false;
+  const SeqRange &range = panRanges[ source ][ rangeIdx ];
+
+  unsigned int seqIdx;
+  if ( !genome->getSeqIndex( rec.qName, seqIdx ) )
+  {
+    std::cout << "Contig in the alignments was not found in the genomes: "
+              << rec.qName << std::endl;
+    exit( 1 );
+  }
+
+  // The source is the query, so hits on the reverse strand run backwards
+  // through the genome instead
+  bool isReverse = rec.sStart > rec.sEnd;
+  hit.qSeqIdx = range.seqIdx;
+  hit.sSeqIdx = seqIdx;
+  hit.qStart  = range.startPos + std::min( rec.sStart, rec.sEnd );
+  hit.qEnd    = range.startPos + std::max( rec.sStart, rec.sEnd );
+  hit.sStart  = isReverse ? rec.qEnd : rec.qStart;
+  hit.sEnd    = isReverse ? rec.qStart : rec.qEnd;
+  hit.length  = rec.length;
+  hit.pIdent  = rec.pIdent;
+  return true;
+}
+
+void BlastData::deriveHits(
+  const GenomeData                                            &genomeData,
+  const unsigned int                                          query,
+  const unsigned int                                          subject,
+  const std::vector< std::vector< std::vector< BlastHit > > > &pairHits,
+  std::vector< BlastHit >                                     &hits
+  ) const
+{
+  const Genome* qGenome = genomeData.getGenomeRefAtIdx( query );
+  const Genome* sGenome = genomeData.getGenomeRefAtIdx( subject );
+  unsigned int  qFirst  = genomeData.getDuplicateOf( query );
+  unsigned int  sFirst  = genomeData.getDuplicateOf( subject );
+
+  // The copies of each contig of the genomes that were searched, on the
+  // forward or reverse strand
+  typedef std::vector< std::vector< std::pair< unsigned int, bool > > > Copies;
+  Copies qCopies( genomeData.getGenomeRefAtIdx( qFirst )->getNumContigs() );
+  Copies sCopies( genomeData.getGenomeRefAtIdx( sFirst )->getNumContigs() );
+  for ( unsigned int i = 0; i < qGenome->getNumContigs(); i++ )
+  {
+    bool isReverse;
+    unsigned int seqIdx = genomeData.getDuplicateSeq( query, i, isReverse );
+    qCopies[ seqIdx ].push_back( { i, isReverse } );
+  }
+  for ( unsigned int i = 0; i < sGenome->getNumContigs(); i++ )
+  {
+    bool isReverse;
+    unsigned int seqIdx = genomeData.getDuplicateSeq( subject, i, isReverse );
+    sCopies[ seqIdx ].push_back( { i, isReverse } );
+  }
+
+  // Genomes that are duplicates of the same genome are aligned end to end,
+  // each contig with the copy of the same contig in the other genome. The
+  // residues that are not bases are not counted as identical, as the
+  // aligners do not count them
+  if ( qFirst == sFirst )
+  {
+    for ( unsigned int c = 0; c < qCopies.size(); c++ )
+    {
+      for ( unsigned int k = 0; k < qCopies[c].size(); k++ )
+      {
+        auto     qCopy  = qCopies[c][k];
+        auto     sCopy  = sCopies[c][ k % sCopies[c].size() ];
+        uint32_t len    = qGenome->getSeqLen( qCopy.first );
+        bool     isRev  = qCopy.second != sCopy.second;
+        double   pIdent = len == 0 ? 100 : 100.0 *
+          ( len - qGenome->getNumAmbiguous( qCopy.first ) ) / len;
+        hits.push_back( { qCopy.first, sCopy.first, 1, len,
+          isRev ? len : 1, isRev ? 1 : len, len, pIdent } );
+      }
+    }
+    return;
+  }
+
+  // Otherwise the hits of the genomes that were searched are mapped onto
+  // the copies of their contigs. If the subject was searched as the query,
+  // the hits are swapped
+  bool         isSwapped = qFirst > sFirst;
+  unsigned int first     = std::min( qFirst, sFirst );
+  unsigned int second    = std::max( qFirst, sFirst );
+  for ( const auto &hit : pairHits[ first ][ second - first - 1 ] )
+  {
+    bool     isMinus = hit.sStart > hit.sEnd;
+    uint32_t sLo     = std::min( hit.sStart, hit.sEnd );
+    uint32_t sHi     = std::max( hit.sStart, hit.sEnd );
+    uint32_t qSeq    = isSwapped ? hit.sSeqIdx : hit.qSeqIdx;
+    uint32_t sSeq    = isSwapped ? hit.qSeqIdx : hit.sSeqIdx;
+    uint32_t qStart  = isSwapped ? sLo : hit.qStart;
+    uint32_t qEnd    = isSwapped ? sHi : hit.qEnd;
+    uint32_t sStart  = isSwapped ? hit.qStart : sLo;
+    uint32_t sEnd    = isSwapped ? hit.qEnd : sHi;
+    for ( const auto &qCopy : qCopies[ qSeq ] )
+    {
+      for ( const auto &sCopy : sCopies[ sSeq ] )
+      {
+        // Positions on a reverse complemented copy are counted from the
+        // other end, and the hit is on the other strand
+        BlastHit copy = hit;
+        uint32_t qLen = qGenome->getSeqLen( qCopy.first ) + 1;
+        uint32_t sLen = sGenome->getSeqLen( sCopy.first ) + 1;
+        copy.qSeqIdx  = qCopy.first;
+        copy.sSeqIdx  = sCopy.first;
+        copy.qStart   = qCopy.second ? qLen - qEnd : qStart;
+        copy.qEnd     = qCopy.second ? qLen - qStart : qEnd;
+        uint32_t lo   = sCopy.second ? sLen - sEnd : sStart;
+        uint32_t hi   = sCopy.second ? sLen - sStart : sEnd;
+        bool     isRev = isMinus != ( qCopy.second != sCopy.second );
+        copy.sStart   = isRev ? hi : lo;
+        copy.sEnd     = isRev ? lo : hi;
+        hits.push_back( copy );
+      }
     }
   }
+}
+
+void BlastData::finishResults( const GenomeData &genomeData )
+{
+  // The unique sequences are extracted through a cache that uses the memory
+  // left in the budget, with a minimium of 64 MB
+  const size_t minCacheSize = size_t( 64 ) << 20;
+  size_t       nResident    = genomeData.getMemUsage();
+  seqCacheSize = minCacheSize;
+  if ( genomeData.getMemBudget() > nResident + minCacheSize )
+    seqCacheSize = genomeData.getMemBudget() - nResident;
 
   // Sort the blast results by the position in the query
   for ( auto &results : blastResults ) results.sortBlastResults();
 
   // Find all alignments that are perfectly within another alignment
   for ( auto &results : blastResults ) results.disentangleAlgns();
+}
+
 
-  // Set the pointers to null before they go out of scope
-  query   = nullptr;
-  subject = nullptr;
+// Search the query against the index of the subject
+bool BlastData::blastFasta(
+  const Genome*           query,
+  const QueryChunk*       chunk,
+  const Genome*           subject,
+  const std::string       &dbPath,
+  std::vector< BlastHit > &hits
+  )
+{
+  return runSearch( query, chunk, dbPath, subject->getGenomeName(),
+    subject->getNumContigs(), [&]( AlignRecord &rec )
+    {
+      BlastHit hit;
+      if ( parseHit( rec, query, subject, hit ) ) hits.push_back( hit );
+    } );
 }
 
+bool BlastData::blastBatch(
+  const Genome*                     query,
+  const QueryChunk*                 chunk,
+  const GenomeData                  &genomeData,
+  const std::vector< unsigned int > &subjects,
+  const std::string                 &aliasPath,
+  std::vector< BlastHit >*          hits
+  )
+{
+  // Find the subjects with each genome tag. Subjects with the same contents
+  // share an index, so their hits are the same
+  std::unordered_map< std::string, std::vector< unsigned int > > tagSubjs;
+  uint32_t nSubjSeqs = 0;
+  for ( unsigned int p = 0; p < subjects.size(); p++ )
+  {
+    auto &subjs = tagSubjs[ getGenomeTag( subjects[p] ) ];
+    if ( subjs.empty() )
+      nSubjSeqs += genomeData.getGenomeRefAtIdx( subjects[p] )->getNumContigs();
+    subjs.push_back( p );
+  }
+
+  return runSearch( query, chunk, aliasPath, "batch", nSubjSeqs,
+    [&]( AlignRecord &rec )
+    {
+      // The subject name is the genome tag and index of the contig written
+      // to the indexes. Replace it with the name of the contig and add the
+      // hit to each subject with that tag
+      size_t sep = rec.sName.rfind( '_' );
+      if ( sep == std::string::npos ) return;
+      auto it = tagSubjs.find( rec.sName.substr( 0, sep ) );
+      if ( it == tagSubjs.end() ) return;
+      unsigned int seqIdx;
+      if ( !parseIndex( rec.sName.substr( sep + 1 ), seqIdx ) ) return;
+      for ( auto p : it->second )
+      {
+        const Genome* subject = genomeData.getGenomeRefAtIdx( subjects[p] );
+        if ( seqIdx >= subject->getNumContigs() ) continue;
+        rec.sName = subject->getContigName( seqIdx );
+        BlastHit hit;
+        if ( parseHit( rec, query, subject, hit ) ) hits[p].push_back( hit );
+      }
+    } );
+}
 
-// Create the blast command to run
-std::string BlastData::blastFasta(
-  const Genome* query,
-  const Genome* subject,
-  const std::string &dbPath,
-  const std::string &outDir
+bool BlastData::runSearch(
+  const Genome*                               query,
+  const QueryChunk*                           chunk,
+  const std::string                           &idxPath,
+  const std::string                           &tsvName,
+  const uint32_t                              nSubjSeqs,
+  const std::function< void( AlignRecord& ) > &onHit
   )
 {
-  std::string outTsv =
-    outDir + query->getGenomeName() + "_" + subject->getGenomeName() + ".tsv";
-  std::string blastCmd = "blastn -query " + query->getFasta() +
-    " -db " + dbPath + " -out " + outTsv +
-     " -outfmt \"6 qseqid sseqid qstart qend sstart send length pident\"";
-  system( blastCmd.c_str() );
-  return outTsv;
+  // Windows are written to the aligner as ranges named by their index in
+  // the window
+  std::vector< SeqRange > ranges;
+  if ( chunk != nullptr )
+  {
+    for ( unsigned int i = 0; i < chunk->size(); i++ )
+    {
+      const ChunkSeg &seg = ( *chunk )[i];
+      ranges.push_back( { seg.seqIdx, seg.startPos, seg.len,
+        "q" + std::to_string( i ) } );
+    }
+  }
+
+  // The hits are only written to disk if they are kept for debugging. Each
+  // window is written to its own file
+  std::string name = query->getGenomeName() + "_" + tsvName;
+  if ( chunk != nullptr )
+  {
+    name += "_" + query->getContigName( chunk->front().seqIdx ) + "_" +
+      std::to_string( chunk->front().startPos );
+  }
+  std::ofstream tsv;
+  if ( keepTsv ) tsv.open( tsvDir + name + ".tsv" );
+
+  // Parse the hits as the aligner reports them
+  bool isDone = aligner->search( query, chunk != nullptr ? &ranges : nullptr,
+    idxPath, nSubjSeqs, [&]( AlignRecord &rec )
+    {
+      if ( keepTsv )
+      {
+        tsv << rec.qName << '\t' << rec.sName << '\t' << rec.qStart << '\t'
+            << rec.qEnd << '\t' << rec.sStart << '\t' << rec.sEnd << '\t'
+            << rec.length << '\t' << rec.pIdent << '\n';
+      }
+      if ( chunk != nullptr && !remapChunkHit( rec, query, *chunk ) ) return;
+      onHit( rec );
+    } );
+  if ( !isDone )
+  {
+    std::cout << "Warning: the search failed for " << name << std::endl;
+  }
+  return isDone;
 }
 
-// Make Blast DB
-std::string BlastData::madeBlastDb(
-  const Genome* genome, const std::string &outDir
+std::vector< BlastData::QueryChunk > BlastData::splitMaskedQuery(
+  const Genome* query, const size_t chunkSize, const size_t chunkOverlap
+  ) const
+{
+  // Masked queries are searched as a single window if they are not split
+  size_t size = chunkSize;
+  if ( size == 0 && query->isMasked() ) size = query->getGenomeSize() + 1;
+  if ( size == 0 ) return {};
+  return splitQuery( query, size, chunkOverlap );
+}
+
+std::vector< BlastData::QueryChunk > BlastData::splitQuery(
+  const Genome* query, const size_t chunkSize, const size_t chunkOverlap
+  ) const
+{
+  std::vector< QueryChunk > chunks( 1 );
+  size_t chunkLen = 0; // Number of residues in the last window
+
+  for ( unsigned int i = 0; i < query->getNumContigs(); i++ )
+  {
+    // Contigs larger than a window are split into pieces, which overlap the
+    // neighboring pieces so that hits spanning the seams are found in full.
+    // The regions of masked contigs that are excluded are not searched
+    for ( const auto &region : query->getSearchedRegions( i ) )
+    {
+      for ( size_t core = region.first; core < region.second;
+        core += chunkSize )
+      {
+        size_t start   = core > region.first + chunkOverlap ?
+          core - chunkOverlap : region.first;
+        size_t end     = std::min( core + chunkSize + chunkOverlap,
+          region.second );
+        size_t len     = end - start;
+        size_t coreLen = std::min( chunkSize, region.second - core );
+
+        // Start a new window once the current window is full
+        if ( chunkLen > 0 && chunkLen + len > chunkSize )
+        {
+          chunks.push_back( QueryChunk() );
+          chunkLen = 0;
+        }
+        chunks.back().push_back( { i, start, len, core - start, coreLen } );
+        chunkLen += len;
+      }
+    }
+  }
+  if ( chunks.back().empty() ) chunks.pop_back();
+  return chunks;
+}
+
+bool BlastData::remapChunkHit(
+  AlignRecord &rec, const Genome* query, const QueryChunk &chunk
+  ) const
+{
+  // The query name is the index of the range in the window
+  if ( rec.qName.size() < 2 || rec.qName[0] != 'q' ) return false;
+  unsigned int segIdx;
+  if ( !parseIndex( rec.qName.substr( 1 ), segIdx ) ||
+    segIdx >= chunk.size() )
+  {
+    return false;
+  }
+  const ChunkSeg &seg = chunk[ segIdx ];
+
+  // Hits are reported by every window whose core they overlap. Hits that
+  // only cover the overlaps are found in full by the neighboring windows.
+  // The pieces of a hit cut at the seams are joined afterwards (see
+  // "joinWindowHits")
+  if ( rec.qEnd <= seg.coreStart || rec.qStart > seg.coreStart + seg.coreLen )
+    return false;
+
+  rec.qName   = query->getContigName( seg.seqIdx );
+  rec.qStart += seg.startPos;
+  rec.qEnd   += seg.startPos;
+  return true;
+}
+
+void BlastData::joinWindowHits(
+  std::vector< BlastHit > &hits, const Genome* query, const Genome* subject
   )
 {
-  // Create the path for the blast database to create
-  std::string dbPath = outDir + genome->getGenomeName();
+  // Hits between the same contigs, on the same strand, are sorted by their
+  // position in the query
+  auto isMinus = []( const BlastHit &hit ) { return hit.sStart > hit.sEnd; };
+  auto isSameGroup = [&isMinus]( const BlastHit &lhs, const BlastHit &rhs )
+  {
+    return lhs.qSeqIdx == rhs.qSeqIdx && lhs.sSeqIdx == rhs.sSeqIdx &&
+      isMinus( lhs ) == isMinus( rhs );
+  };
+  std::stable_sort( hits.begin(), hits.end(),
+    [&isMinus]( const BlastHit &lhs, const BlastHit &rhs )
+    {
+      if ( lhs.qSeqIdx != rhs.qSeqIdx ) return lhs.qSeqIdx < rhs.qSeqIdx;
+      if ( lhs.sSeqIdx != rhs.sSeqIdx ) return lhs.sSeqIdx < rhs.sSeqIdx;
+      if ( isMinus( lhs ) != isMinus( rhs ) ) return isMinus( rhs );
+      if ( lhs.qStart != rhs.qStart ) return lhs.qStart < rhs.qStart;
+      return lhs.qEnd > rhs.qEnd;
+    } );
 
-  // Make the blast database
-  std::string cmd =
-    "makeblastdb -dbtype nucl -in " + genome->getFasta() + " -out " + dbPath;
-  system( cmd.c_str() );
+  // The earlier hits of the group that reach the start of a hit are those
+  // it may be a piece of, and are tried from the last one found
+  std::vector< BlastHit > joined;
+  std::vector< size_t >   active;
+  for ( const auto &hit : hits )
+  {
+    if ( !active.empty() && !isSameGroup( joined[ active[0] ], hit ) )
+      active.clear();
+    size_t nActive = 0;
+    for ( auto idx : active )
+      if ( joined[ idx ].qEnd >= hit.qStart ) active[ nActive++ ] = idx;
+    active.resize( nActive );
 
-  return dbPath;
+    bool isJoined = false;
+    for ( auto it = active.rbegin(); !isJoined && it != active.rend(); it++ )
+      isJoined = joinHit( joined[ *it ], hit, query, subject );
+    if ( isJoined ) continue;
+    active.push_back( joined.size() );
+    joined.push_back( hit );
+  }
+  hits.swap( joined );
 }
 
-void BlastData::findUniqueAligns( const std::string &outFile )
+bool BlastData::joinHit(
+  BlastHit &prev, const BlastHit &hit, const Genome* query,
+  const Genome* subject
+  )
 {
+  // Positions in the subject are negated on the minus strand, so that they
+  // increase along the query on either strand
+  bool isMinus = prev.sStart > prev.sEnd;
+  auto sPos    = [isMinus]( uint32_t pos )
+  {
+    return isMinus ? -int64_t( pos ) : int64_t( pos );
+  };
+  int64_t prevStart = sPos( prev.sStart );
+  int64_t prevEnd   = sPos( prev.sEnd );
+  int64_t hitStart  = sPos( hit.sStart );
+  int64_t hitEnd    = sPos( hit.sEnd );
+  if ( hitStart < prevStart || hitStart > prevEnd + 1 ) return false;
+
+  // A hit within the earlier hit that starts or ends where it does was
+  // found whole by the windows on both sides of a seam
+  if ( hit.qEnd <= prev.qEnd && hitEnd <= prevEnd )
+  {
+    return ( hit.qStart == prev.qStart && hitStart == prevStart ) ||
+      ( hit.qEnd == prev.qEnd && hitEnd == prevEnd );
+  }
+  if ( hit.qEnd <= prev.qEnd || hitEnd <= prevEnd ) return false;
+
+  // The residues both pieces align are aligned again, and must have no
+  // more differences than either piece has in total if the pieces are of
+  // the same alignment. Their columns are then only counted once
+  auto getDiffs = []( const BlastHit &h )
+  {
+    return size_t( std::ceil( h.length * ( 100.0 - h.pIdent ) / 100.0 -
+      1e-6 ) );
+  };
+  size_t qLen = prev.qEnd - hit.qStart + 1;
+  size_t sLen = prevEnd - hitStart + 1;
+  size_t sPos0 = isMinus ? prev.sEnd - 1 : hit.sStart - 1;
+  size_t nCols;
+  size_t nDiffs;
+  if ( !alignOverlap( query, hit.qSeqIdx, hit.qStart - 1, qLen, subject,
+    hit.sSeqIdx, sPos0, sLen, isMinus,
+    std::min( getDiffs( prev ), getDiffs( hit ) ), nCols, nDiffs ) )
+  {
+    return false;
+  }
+  int64_t matches = std::llround( prev.length * prev.pIdent / 100.0 ) +
+    std::llround( hit.length * hit.pIdent / 100.0 ) -
+    int64_t( nCols - nDiffs );
+  prev.length = prev.length + hit.length - nCols;
+  prev.pIdent = 100.0 * std::max( matches, int64_t( 0 ) ) / prev.length;
+  prev.qEnd   = hit.qEnd;
+  prev.sEnd   = hit.sEnd;
+  return true;
+}
+
+bool BlastData::alignOverlap(
+  const Genome* query, const unsigned int qSeqIdx, const size_t qStart,
+  const size_t qLen, const Genome* subject, const unsigned int sSeqIdx,
+  const size_t sStart, const size_t sLen, const bool isMinus,
+  const size_t maxDiffs, size_t &nCols, size_t &nDiffs
+  )
+{
+  int64_t shift = int64_t( sLen ) - int64_t( qLen );
+  if ( size_t( std::abs( shift ) ) > maxDiffs ) return false;
+
+  std::string qSeq( qLen, 'N' );
+  std::string sSeq( sLen, 'N' );
+  if ( qLen > 0 ) query->decodeSeq( qSeqIdx, qStart, qLen, &qSeq[0] );
+  if ( sLen > 0 ) subject->decodeSeq( sSeqIdx, sStart, sLen, &sSeq[0] );
+  for ( auto &c : qSeq ) c = toupper( c );
+  for ( auto &c : sSeq ) c = toupper( c );
+  if ( isMinus )
+  {
+    std::reverse( sSeq.begin(), sSeq.end() );
+    for ( auto &c : sSeq )
+    {
+      switch ( c )
+      {
+        case 'A': c = 'T'; break;
+        case 'C': c = 'G'; break;
+        case 'G': c = 'C'; break;
+        case 'T': c = 'A'; break;
+        default:  c = 'N'; break;
+      }
+    }
+  }
+
+  // The fewest differences, and then the fewest columns, of an alignment of
+  // the residues end to end. Each cell is on a diagonal of the band, which
+  // is widened until it holds every alignment with as many differences as
+  // the best one found, or as many as are allowed
+  const uint64_t inf = UINT64_MAX;
+  for ( size_t band = 16; ; band *= 2 )
+  {
+    band = std::min( band, maxDiffs );
+    int64_t  dLo   = std::min( int64_t( 0 ), shift ) - int64_t( band );
+    int64_t  dHi   = std::max( int64_t( 0 ), shift ) + int64_t( band );
+    size_t   width = dHi - dLo + 1;
+
+    // Differences and columns are packed into one score, differences first
+    auto score = []( uint64_t diffs, uint64_t cols )
+    {
+      return ( diffs << 32 ) | cols;
+    };
+    std::vector< uint64_t > prevRow( width, inf );
+    std::vector< uint64_t > row( width, inf );
+    for ( int64_t d = std::max( dLo, int64_t( 0 ) );
+      d <= std::min( dHi, int64_t( sLen ) ); d++ )
+    {
+      prevRow[ d - dLo ] = score( d, d );
+    }
+    for ( size_t i = 1; i <= qLen; i++ )
+    {
+      std::fill( row.begin(), row.end(), inf );
+      for ( int64_t d = dLo; d <= dHi; d++ )
+      {
+        int64_t j = int64_t( i ) + d;
+        if ( j < 0 || j > int64_t( sLen ) ) continue;
+        uint64_t best = inf;
+        size_t   k    = d - dLo;
+        if ( j > 0 && prevRow[k] != inf )
+        {
+          bool isMatch = qSeq[ i - 1 ] == sSeq[ j - 1 ] &&
+            qSeq[ i - 1 ] != 'N';
+          best = prevRow[k] + score( !isMatch, 1 );
+        }
+        if ( k + 1 < width && prevRow[ k + 1 ] != inf )
+          best = std::min( best, prevRow[ k + 1 ] + score( 1, 1 ) );
+        if ( k > 0 && j > 0 && row[ k - 1 ] != inf )
+          best = std::min( best, row[ k - 1 ] + score( 1, 1 ) );
+        row[k] = best;
+      }
+      prevRow.swap( row );
+    }
+
+    uint64_t end = prevRow[ shift - dLo ];
+    if ( end != inf && ( end >> 32 ) <= band )
+    {
+      nDiffs = end >> 32;
+      nCols  = end & 0xffffffff;
+      return nDiffs <= maxDiffs;
+    }
+    if ( band >= maxDiffs ) return false;
+  }
+}
+
+bool BlastData::parseHit(
+  const AlignRecord &rec, const Genome* query, const Genome* subject,
+  BlastHit &hit
+  ) const
+{
+  // Hits are stored by the index of their contigs, so that they do not
+  // depend on the ids assigned to the contigs in this run
+  unsigned int qSeqIdx;
+  unsigned int sSeqIdx;
+  if ( !query->getSeqIndex( rec.qName, qSeqIdx ) ||
+    !subject->getSeqIndex( rec.sName, sSeqIdx ) )
+  {
+    std::cout << "Contig in the alignments was not found in the genomes: "
+              << rec.qName << ", " << rec.sName << std::endl;
+    exit( 1 );
+  }
+  hit.qSeqIdx = qSeqIdx;
+  hit.sSeqIdx = sSeqIdx;
+  hit.qStart  = rec.qStart;
+  hit.qEnd    = rec.qEnd;
+  hit.sStart  = rec.sStart;
+  hit.sEnd    = rec.sEnd;
+  hit.length  = rec.length;
+  hit.pIdent  = rec.pIdent;
+  return true;
+}
+
+BlastResults BlastData::mergeGroups( const unsigned int nGroups )
+{
+  // Split the query genomes into consecutive groups with about the same
+  // number of alignments. Each group starts with at least one genome
+  unsigned int nResults = blastResults.size();
+  unsigned int nSplits  = std::min( nGroups, nResults );
+  size_t       nTotal   = 0;
+  for ( auto &results : blastResults ) nTotal += results.nAligns();
+  std::vector< unsigned int > firsts = { 0 };
+  size_t nSeen = 0;
+  for ( unsigned int i = 0; i < nResults; i++ )
+  {
+    unsigned int nLeft = nResults - i;
+    unsigned int g     = firsts.size();
+    if ( g < nSplits && i > firsts.back() &&
+      ( nSeen * nSplits >= nTotal * g || nLeft == nSplits - g ) )
+    {
+      firsts.push_back( i );
+    }
+    nSeen += blastResults[i].nAligns();
+  }
+  firsts.push_back( nResults );
+  std::cout << "  -- Merging " << firsts.size() - 1 << " groups of genomes"
+            << std::endl;
+
+  // Find the unique alignments of each group. Alignments of the same query
+  // genome are never equivalent to each other, so the alignments of each
+  // genome are only compared to those kept from the genomes before it
+  ThreadPool                  pool( nThreads );
+  std::vector< BlastResults > groups;
+  groups.reserve( firsts.size() - 1 );
+  for ( unsigned int g = 0; g + 1 < firsts.size(); g++ )
+    groups.push_back( BlastResults( blastResults[ firsts[g] ] ) );
+  for ( unsigned int g = 0; g < groups.size(); g++ )
+  {
+    pool.addJob( [this, g, &groups, &firsts]()
+      {
+        for ( unsigned int i = firsts[g] + 1; i < firsts[ g + 1 ]; i++ )
+        {
+          BlastResults results = blastResults[i];
+          groups[g].mergeUnique( results );
+        }
+      } );
+  }
+  pool.wait();
+
+  // Merge neighboring groups in pairs until one is left. The groups of
+  // each level are merged in parallel
+  for ( size_t step = 1; step < groups.size(); step *= 2 )
+  {
+    for ( size_t g = 0; g + step < groups.size(); g += 2 * step )
+    {
+      pool.addJob( [g, step, &groups]()
+        { groups[g].mergeUnique( groups[ g + step ] ); } );
+    }
+    pool.wait();
+  }
+  return groups[0];
+}
+
+std::string BlastData::getGenomeTag( const unsigned int genomeIdx ) const
+{
+  return "g" + hashToHex( genomeHashes[ genomeIdx ] );
+}
+
+bool BlastData::parseIndex( const std::string &str, unsigned int &idx )
+{
+  size_t        len = 0;
+  unsigned long val;
+  try
+  {
+    val = std::stoul( str, &len );
+  }
+  catch ( const std::logic_error & )
+  {
+    return false;
+  }
+  if ( len != str.size() || !isdigit( str[0] ) || val > UINT_MAX )
+    return false;
+  idx = val;
+  return true;
+}
+
+void BlastData::findUniqueAligns(
+  const std::string &outFile, const unsigned int lineWidth,
+  const unsigned int nGroups
+  )
+{
+  std::cout << "findUniqueAligns: " << std::endl
+            << "  -- Begin: " << blastResults[0].nAligns() << std::endl;
+
   // Initialize to the unique alignments to the first set of alignments is
   // these data. Copy constructore makes a deep copy.
-  BlastResults   uniqueAlgns = blastResults[0];
+  bool           isTree      = nGroups > 1 && blastResults.size() > 1;
+  BlastResults   uniqueAlgns = isTree ? mergeGroups( nGroups ) :
+    blastResults[0];
   BlastAlignment algn;
 
-  std::cout << "findUniqueAligns: " << std::endl
-            << "  -- Begin: " << uniqueAlgns.nAligns() << std::endl;
-  for ( unsigned int i = 1; i < blastResults.size(); i++ )
+  for ( unsigned int i = 1; !isTree && i < blastResults.size(); i++ )
   {
     while ( blastResults[i] >> algn )
     {
@@ -143,7 +1632,8 @@ void BlastData::findUniqueAligns( const std::string &outFile )
 
   while( uniqueAlgns >> algn ) algn.printAlign();
   // Write a fasta file for these sequences
-  uniqueAlgns.writeAlgnSeqs( outFile + "seqs.fasta" );
+  uniqueAlgns.writeAlgnSeqs( outFile + "seqs.fasta", lineWidth,
+    seqCacheSize );
 }
 
 // -----------------------------------------------------------------------------
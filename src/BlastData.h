@@ -1,10 +1,23 @@
 #include "BlastResults.h"
 #include "BlastAlignment.h"
 #include "GenomeData.h"
+#include "ThreadPool.h"
+#include "Aligner.h"
+#include "BlastCache.h"
+#include "WorkQueue.h"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 
 // -----------------------------------------------------------------------------
 // BlastData
@@ -21,35 +34,260 @@
 
 #ifndef _BLAST_DATA_
 #define _BLAST_DATA_
+
 class BlastData
 {
 public:
 
   // Ctor: take the parsed genome data, and an output directory to write
   // files. Additionally, the minimum identity and minimium length for
-  // alignments are input.
-  BlastData( const GenomeData &genomeData, const std::string &outDir,
-    const double &minIdent, const unsigned int minLen );
+  // alignments are input. If the genome data has a memory budget, each
+  // genome is released once all of its alignments have been parsed. The
+  // blast databases and searches are run concurrently on "nThreads"
+  // threads (zero for one per core). The output of blastn is parsed as it
+  // is written; if "keepTsv" is true it is also saved to "blast_results/"
+  // in the output directory. If "isBatched" is true each query genome is
+  // blasted once against the combined databases of the genomes after it,
+  // rather than once per subject. Query genomes are split into windows of
+  // about "chunkSize" nts, overlapping by "chunkOverlap" nts, which are
+  // searched as separate jobs, and the hits cut at the seams of the
+  // windows are joined. If "chunkSize" is zero queries are not split, so
+  // the hits do not depend on the number of threads. If "blastCacheDir" is
+  // set the databases and hits are cached there, keyed on the contents of
+  // the genomes, and pairs searched by earlier runs are not searched again.
+  // If "isGreedy" is true the genomes are added to a pan-genome in order
+  // instead of being compared pairwise (see "alignPanGenome"), and nothing
+  // is cached. If "workDir" is set the searches are queued there, and run
+  // by this process together with any workers that share the directory
+  // (see "WorkQueue"). The genomes are indexed and searched with "aligner".
+  BlastData( GenomeData &genomeData, const std::string &outDir,
+    const double &minIdent, const unsigned int minLen,
+    const unsigned int nThreads, const bool keepTsv, const bool isBatched,
+    const bool isGreedy, const size_t chunkSize, const size_t chunkOverlap,
+    const std::string &blastCacheDir, const std::string &workDir,
+    Aligner &aligner );
+
+  // Worker ctor: run the searches queued in "workDir" by a coordinator on
+  // "nThreads" threads until every search is finished. The genomes and the
+  // settings of the searches must match those of the coordinator. Nothing
+  // is parsed, so the results are left empty
+  BlastData( GenomeData &genomeData, const std::string &workDir,
+    const unsigned int minLen, const unsigned int nThreads,
+    const bool isBatched, Aligner &aligner );
 
   // Dtor
   BlastData()
   { ; }
 
-  // Get all of the unique sequences in the blast alignments
-  void findUniqueAligns( const std::string &outFile );
+  // Get all of the unique sequences in the blast alignments and write them
+  // to a fasta file, wrapping lines at "lineWidth" residues if it is not zero.
+  // If "nGroups" is more than one the query genomes are split into groups
+  // with about the same number of alignments. The unique alignments of each
+  // group are found in parallel, and the groups are merged in pairs, in a
+  // balanced tree, comparing only the alignments kept by each group
+  void findUniqueAligns( const std::string &outFile,
+    const unsigned int lineWidth = 0, const unsigned int nGroups = 1 );
 
 private:
 
+  // A range of a contig in a window of a query genome. Hits are kept by
+  // every window whose core they overlap; the overlap on either side of the
+  // core is only searched so that hits crossing the edges of the core are
+  // found in full.
+  struct ChunkSeg
+  {
+    unsigned int seqIdx;    // Index of the contig in the genome
+    size_t       startPos;  // Position of the first residue in the contig
+    size_t       len;       // Number of residues, including the overlap
+    size_t       coreStart; // Offset of the core from the first residue
+    size_t       coreLen;   // Number of residues in the core
+  };
+
+  // A window of a query genome, searched as a single job. Large contigs are
+  // split into overlapping pieces and small contigs are grouped together
+  typedef std::vector< ChunkSeg > QueryChunk;
+
+  // A search of a query genome, or of a window of it, against one subject
+  // or, in batched mode, against the combined indexes of its subjects
+  struct BlastJob
+  {
+    unsigned int                query;    // Index of the query genome
+    int                         chunk;    // Index of the query window, or -1
+    std::vector< unsigned int > subjects; // Indexes of the subject genomes
+    double                      cost;     // Estimated cost of the search
+  };
+
   // Vector of the blast results for each fasta fle
   std::vector< BlastResults > blastResults;
 
-  // Make a blast database for the input fasta file
-  std::string madeBlastDb( const Genome* genome, const std::string &outDir );
+  // Hash of the contents of each genome
+  std::vector< uint64_t > genomeHashes;
+
+  // Align the query genome, or a window of it if "chunk" is not null,
+  // against the index of the subject, and parse the hits into "hits" as
+  // they are reported. Returns false if the search failed
+  bool blastFasta( const Genome* query, const QueryChunk* chunk,
+    const Genome* subject, const std::string &dbPath,
+    std::vector< BlastHit > &hits );
+
+  // Align the query genome, or a window of it, against the combined
+  // indexes of the subject genomes. The hits are assigned to their subject
+  // genome, and the hits for "subjects[p]" are parsed into "hits[p]".
+  // Returns false if the search failed
+  bool blastBatch( const Genome* query, const QueryChunk* chunk,
+    const GenomeData &genomeData, const std::vector< unsigned int > &subjects,
+    const std::string &aliasPath, std::vector< BlastHit >* hits );
+
+  // Describe the aligner and the settings that change the hits, which
+  // identify the hits in the cache. If "isQueued" is true the version of
+  // the aligner and a hash of the genomes are added, which the coordinator
+  // and the workers must share
+  std::string getSearchParams( const GenomeData &genomeData,
+    const unsigned int minLen, const bool isQueued ) const;
+
+  // Write a search to a job of the work queue. The genomes are identified
+  // by their hashes, so the job does not depend on the order of the genomes
+  // of the process that runs it, and the index by its absolute path
+  std::string encodeJob( const BlastJob &job, const QueryChunk* chunk,
+    const std::string &idxPath ) const;
+
+  // Run a job of the work queue and write its hits to "shard": whether the
+  // search succeeded, followed by the hits against each subject. Exits if
+  // the job names a genome that was not input
+  void runQueuedJob( const GenomeData &genomeData,
+    const std::unordered_map< uint64_t, unsigned int > &hashIdxs,
+    const std::string &job, std::string &shard );
+
+  // Claim and run the jobs of the queue on the threads of the pool until
+  // every job has a shard. The claims of this process are touched while
+  // the jobs run. The coordinator also returns stale claims to the queue
+  void runQueue( WorkQueue &queue, const GenomeData &genomeData,
+    ThreadPool &pool, const bool isCoordinator );
+
+  // Add the genomes to a pan-genome in order. Each genome is searched only
+  // against the regions the earlier genomes added to the pan-genome, and
+  // adds the regions of at least "minLen" nts that are not covered by a
+  // hit of at least "minLen" nts and "minIdent". Each hit is assigned to
+  // the earlier genome, as the query, so the hits are parsed as they are in
+  // pairwise mode. The number of searches grows with the number of genomes,
+  // rather than the number of pairs, and each is bounded by the size of the
+  // pan-genome
+  void alignPanGenome( GenomeData &genomeData, const double &minIdent,
+    const unsigned int minLen, const std::string &dbDir,
+    const size_t chunkSize, const size_t chunkOverlap, ThreadPool &pool );
+
+  // Convert a hit of a genome against the pan-genome into a hit of the
+  // genome that added the region, as the query, against the genome. The
+  // regions of genome "g" are named "p<g>_<index of the region>". Returns
+  // false if the hit is not against a region in "panRanges"
+  bool parsePanHit( const AlignRecord &rec, const Genome* genome,
+    const std::vector< std::vector< SeqRange > > &panRanges,
+    unsigned int &source, BlastHit &hit ) const;
+
+  // Copy the hits of the genomes searched in place of the query and subject
+  // genomes, at least one of which is a duplicate of another genome, onto
+  // the contigs of the query and subject
+  void deriveHits( const GenomeData &genomeData, const unsigned int query,
+    const unsigned int subject,
+    const std::vector< std::vector< std::vector< BlastHit > > > &pairHits,
+    std::vector< BlastHit > &hits ) const;
+
+  // Find the unique alignments of up to "nGroups" groups of query genomes
+  // in parallel and merge the groups in a tree (see "findUniqueAligns")
+  BlastResults mergeGroups( const unsigned int nGroups );
+
+  // Sort and collapse the parsed hits, and size the cache used to extract
+  // the unique sequences from the memory left in the budget
+  void finishResults( const GenomeData &genomeData );
+
+  // Search the query, or a window of it, against the index at "idxPath",
+  // which has "nSubjSeqs" contigs. Each hit is passed to "onHit", with the
+  // coordinates of windows mapped back to the contigs. "tsvName" is used to
+  // name the hits if they are kept. Returns false if the search failed
+  bool runSearch( const Genome* query, const QueryChunk* chunk,
+    const std::string &idxPath, const std::string &tsvName,
+    const uint32_t nSubjSeqs,
+    const std::function< void( AlignRecord& ) > &onHit );
+
+  // Split a query genome into windows with cores of about "chunkSize" nts.
+  // Where a contig is split, each piece extends "chunkOverlap" nts past the
+  // edges of its core
+  std::vector< QueryChunk > splitQuery( const Genome* query,
+    const size_t chunkSize, const size_t chunkOverlap ) const;
+
+  // Split a query genome into windows if "chunkSize" is set. Masked
+  // queries are always split, into a single window if need be, so that the
+  // regions they exclude are not searched. Returns no windows if the query
+  // is searched whole
+  std::vector< QueryChunk > splitMaskedQuery( const Genome* query,
+    const size_t chunkSize, const size_t chunkOverlap ) const;
+
+  // Join the pieces of the hits that were cut at the seams of the windows
+  // of a query: a hit that starts within an earlier hit between the same
+  // contigs, and extends it in both genomes, extends it (see "joinHit").
+  // Hits are left sorted by their contigs, strand and position in the query
+  static void joinWindowHits( std::vector< BlastHit > &hits,
+    const Genome* query, const Genome* subject );
+
+  // Join "hit" to the earlier hit "prev" if it is a piece of the same
+  // alignment. The residues that both pieces align are aligned again, and
+  // the pieces are joined if that takes no more differences than either
+  // piece has, with the columns of the overlap counted once. A hit within
+  // "prev" that starts or ends where it does is dropped. Returns false if
+  // "hit" is a separate alignment
+  static bool joinHit( BlastHit &prev, const BlastHit &hit,
+    const Genome* query, const Genome* subject );
+
+  // Align "qLen" residues of a query contig from "qStart" end to end with
+  // "sLen" residues of a subject contig from "sStart", which are reverse
+  // complemented if "isMinus" is set. Positions are zero based. Sets the
+  // number of columns and of differences of the alignment with the fewest
+  // differences. Returns false if it has more than "maxDiffs" differences
+  static bool alignOverlap( const Genome* query, const unsigned int qSeqIdx,
+    const size_t qStart, const size_t qLen, const Genome* subject,
+    const unsigned int sSeqIdx, const size_t sStart, const size_t sLen,
+    const bool isMinus, const size_t maxDiffs, size_t &nCols,
+    size_t &nDiffs );
+
+  // Map the query name and coordinates of a hit in a window to the contig.
+  // Returns false if the hit does not overlap the core of the window, in
+  // which case it is reported by a neighboring window
+  bool remapChunkHit( AlignRecord &rec, const Genome* query,
+    const QueryChunk &chunk ) const;
+
+  // Convert a hit reported by the aligner into a hit between contigs of the
+  // query and subject. Exits if the contigs are not in the genomes
+  bool parseHit( const AlignRecord &rec, const Genome* query,
+    const Genome* subject, BlastHit &hit ) const;
+
+  // Return the tag used to name the contigs of a genome in the indexes
+  // searched in batched mode, which is made from the hash of the genome
+  std::string getGenomeTag( const unsigned int genomeIdx ) const;
+
+  // Read an index from the name of a sequence reported by the aligner.
+  // Returns false if the string is not a number, so that a malformed line
+  // is treated as a failed parse
+  static bool parseIndex( const std::string &str, unsigned int &idx );
+
+  // Directory to write the blast output to if it is kept
+  std::string tsvDir;
+
+  // True if the blast output is written to "tsvDir"
+  bool keepTsv;
+
+  // True if each query is blasted against all of its subjects at once
+  bool isBatched;
+
+  // Aligner used to index and search the genomes. Only set while the
+  // genomes are aligned in the ctor
+  Aligner* aligner = nullptr;
+
+  // Number of threads used to align the genomes and merge their alignments
+  unsigned int nThreads;
 
-  // Use blastn to generate the alignments against the input fasta file and
-  // the blast database
-  std::string blastFasta( const Genome* query, const Genome* subject,
-    const std::string &dbPath, const std::string &outDir );
+  // Number of bytes of decoded sequence to cache when the unique sequences
+  // are extracted from genomes that are not resident
+  size_t seqCacheSize;
 };
 #endif
 
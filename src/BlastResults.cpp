@@ -60,18 +60,45 @@ bool BlastResults::parseBlastData(
   if ( ifs.peek() == std::ifstream::traits_type::eof() ) return false;
 
   // Read in the file line by line
-  while ( getline( ifs, line ) )
-  {
-    // Parse the line in the blast data
-    std::stringstream ss( line );
-    BlastAlignment    algn( ss, query, subject );
-
-    // If this alignment is sufficiently high identity,
-    if ( algn.subjects[0].pIdent >= minIdent ) alignments.push_back( algn );
-  }
+  while ( getline( ifs, line ) ) parseBlastLine( line, query, subject );
   return true;
 }
 
+void BlastResults::parseBlastLine(
+  const std::string &line, const Genome* query, const Genome* subject
+  )
+{
+  if ( line.empty() ) return;
+
+  // Parse the line in the blast data
+  std::stringstream ss( line );
+  BlastAlignment    algn( ss, query, subject );
+
+  // If this alignment is sufficiently high identity,
+  if ( algn.subjects[0].pIdent >= minIdent ) alignments.push_back( algn );
+}
+
+void BlastResults::addHit(
+  const BlastHit &hit, const Genome* query, const Genome* subject
+  )
+{
+  if ( hit.pIdent < minIdent ) return;
+
+  // Positions are zero based, and the subject positions are in increasing
+  // order whatever the strand of the hit
+  BlastAlignment algn;
+  algn.query  = query;
+  algn.qSeqId = query->getSeqIdBase() + hit.qSeqIdx;
+  algn.qStart = hit.qStart - 1;
+  algn.qEnd   = hit.qEnd - 1;
+  algn.length = hit.length;
+  algn.subjects.push_back( Subject( subject->getSeqIdBase() + hit.sSeqIdx,
+    algn.qStart, algn.qEnd, std::min( hit.sStart, hit.sEnd ) - 1,
+    std::max( hit.sStart, hit.sEnd ) - 1, hit.length, hit.pIdent,
+    subject ) );
+  alignments.push_back( algn );
+}
+
 void BlastResults::sortBlastResults()
 {
   alignments.sort( );
@@ -169,6 +196,12 @@ void BlastResults::addAlignment( BlastAlignment algn )
   alignments.push_back( algn );
 }
 
+void BlastResults::appendResults( BlastResults &rhs )
+{
+  alignments.splice( alignments.end(), rhs.alignments );
+  rhs.it = rhs.alignments.begin();
+}
+
 bool BlastResults::find( BlastAlignment &algn )
 {
   // Set the iterator at the first alignment
@@ -187,27 +220,94 @@ bool BlastResults::find( BlastAlignment &algn )
   return false;
 }
 
+void BlastResults::mergeUnique( BlastResults &rhs )
+{
+  // An input alignment has an equivalent here if the span of a subject of
+  // one of these alignments, on the contig it aligns, contains it (see
+  // "BlastAlignment::checkIsEquiv"). The spans of the subjects and the
+  // input alignments are sorted by their contig and start, so each input
+  // alignment is compared to the furthest end of the spans that start at
+  // or before it in a single pass over both
+  std::vector< std::tuple< uint32_t, unsigned int, unsigned int > > spans;
+  for ( const auto &algn : alignments )
+    for ( const auto &subj : algn.subjects )
+      spans.emplace_back( subj.sSeqId, subj.sStart, subj.sEnd );
+  std::sort( spans.begin(), spans.end() );
+
+  // The input alignments are only compared to the alignments already in
+  // these results, not to each other, and keep their order
+  std::vector< std::list< BlastAlignment >::iterator > inputs;
+  for ( auto rIt = rhs.alignments.begin(); rIt != rhs.alignments.end();
+    rIt++ )
+  {
+    inputs.push_back( rIt );
+  }
+  std::sort( inputs.begin(), inputs.end(),
+    []( const std::list< BlastAlignment >::iterator &lhs,
+      const std::list< BlastAlignment >::iterator &rhs )
+    {
+      if ( lhs->qSeqId != rhs->qSeqId ) return lhs->qSeqId < rhs->qSeqId;
+      return lhs->qStart < rhs->qStart;
+    } );
+  size_t   spanIdx = 0;
+  uint32_t seqId   = 0;
+  int64_t  maxEnd  = -1;
+  for ( const auto &algn : inputs )
+  {
+    if ( algn->qSeqId != seqId )
+    {
+      seqId  = algn->qSeqId;
+      maxEnd = -1;
+    }
+    for ( ; spanIdx < spans.size(); spanIdx++ )
+    {
+      const auto &span = spans[ spanIdx ];
+      if ( std::get< 0 >( span ) > seqId || ( std::get< 0 >( span ) ==
+        seqId && std::get< 1 >( span ) > algn->qStart ) )
+      {
+        break;
+      }
+      if ( std::get< 0 >( span ) == seqId )
+        maxEnd = std::max( maxEnd, int64_t( std::get< 2 >( span ) ) );
+    }
+    if ( maxEnd >= algn->qEnd ) rhs.alignments.erase( algn );
+  }
+  appendResults( rhs );
+  it = alignments.begin();
+}
+
 unsigned int BlastResults::nAligns()
 {
   return alignments.size();
 }
 
-bool BlastResults::writeAlgnSeqs( const std::string &outFile )
+bool BlastResults::writeAlgnSeqs(
+  const std::string &outFile, const unsigned int lineWidth,
+  const size_t cacheSize
+  )
 {
-  // Initialize a "BioSeq" class object to store the deduplicated sequeces
-  BioSeq      alignedSeqs;
-  std::string faHeader;
-  std::string seq;
+  // Initialize a writer to extract the deduplicated sequeces
+  SeqCache    seqCache( cacheSize );
+  FastaWriter writer( lineWidth, &seqCache );
 
-  // Iterate over the blast results and extract the aligned sequences
+  // Iterate over the blast results and request the aligned sequences. The
+  // sequences are decoded from the genomes when the file is written
   for ( auto it = alignments.begin(); it != alignments.end(); it++ )
   {
-    it->getAlignSeq( faHeader, seq );
-    alignedSeqs.addSeq( faHeader, seq );
+    const Genome* query  = it->query;
+    unsigned int  seqIdx = query->getSeqIdx( it->qSeqId );
+    size_t        seqLen = query->getSeqLen( seqIdx );
+
+    // Skip alignments that are not valid coordinates in the query. The
+    // alignment is clipped at the end of the contig
+    if ( it->qStart >= it->qEnd || it->qEnd > seqLen ) continue;
+    size_t len = std::min( size_t( it->qEnd - it->qStart + 1 ),
+      seqLen - it->qStart );
+    writer.addSeq( query, seqIdx, it->qStart, len, it->getAlignName() );
   }
 
   // Write the fasta file with the unique sequences
-  return alignedSeqs.writeSeqs( outFile );
+  return writer.write( outFile );
 }
 
 bool BlastResults::splitAlign(
@@ -1,10 +1,13 @@
 #include "BlastAlignment.h"
+#include "BlastCache.h"
 #include "Genome.h"
 #include "BioSeq.h"
+#include "FastaWriter.h"
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <list>
+#include <tuple>
 #include <string>
 
 // -----------------------------------------------------------------------------
@@ -47,24 +50,48 @@ public:
   bool parseBlastData( std::string path, const Genome* query,
     const Genome* subject );
 
+  // Parse a single line of blast output and add the alignment if it passes
+  // the identity threshold
+  void parseBlastLine( const std::string &line, const Genome* query,
+    const Genome* subject );
+
+  // Add the alignment of a hit between contigs of the query and subject if
+  // it passes the identity threshold. The contig ids are taken from the
+  // indexes of the contigs in the hit, so no names are looked up
+  void addHit( const BlastHit &hit, const Genome* query,
+    const Genome* subject );
+
   // Identify alignments that fall within each other and
   bool collapseNestedAligns();
 
   // Add an alignment to the vector of alignments
   void addAlignment( BlastAlignment algn );
 
+  // Move the alignments of the input results to the end of these results.
+  // The input results are left empty
+  void appendResults( BlastResults &rhs );
+
   // Search over the blast alignments and determine if there is an equivalent
   // alignment present in these alignments
   bool find( BlastAlignment &algn );
 
+  // Move the alignments of the input results that have no equivalent
+  // alignment in these results to the end of these results. The input
+  // results are left empty
+  void mergeUnique( BlastResults &rhs );
+
   // Return the number of alignments in
   unsigned int nAligns();
 
   // Stream operator for accessing alignments
   friend bool operator>>( BlastResults &blastResults, BlastAlignment &algn );
 
-  // Write a multi fasta file with the aligned sequeces
-  bool writeAlgnSeqs( const std::string &outFile );
+  // Write a multi fasta file with the aligned sequeces. Lines are wrapped
+  // at "lineWidth" residues, or not at all if it is zero. Sequences of
+  // genomes that are not resident are read through a cache of up to
+  // "cacheSize" bytes
+  bool writeAlgnSeqs( const std::string &outFile,
+    const unsigned int lineWidth = 0, const size_t cacheSize = 64 << 20 );
 
 
   void disentangleAlgns();
@@ -0,0 +1,68 @@
+#include "Dust.h"
+
+// -----------------------------------------------------------------------------
+// Dust
+// Ryan D. Crawford
+// 2020/07/27
+// -----------------------------------------------------------------------------
+
+// ---- Dust functions ---------------------------------------------------------
+
+// Return the code of the triplet starting at the input residue, or -1 if
+// one of its residues is not a base
+static int tripletCode( const char* seq )
+{
+  int code = 0;
+  for ( int i = 0; i < 3; i++ )
+  {
+    switch ( seq[i] )
+    {
+      case 'A': case 'a': code = code * 4;     break;
+      case 'C': case 'c': code = code * 4 + 1; break;
+      case 'G': case 'g': code = code * 4 + 2; break;
+      case 'T': case 't': code = code * 4 + 3; break;
+      default: return -1;
+    }
+  }
+  return code;
+}
+
+void findLowComplexity(
+  const char*                                 seq,
+  const size_t                                len,
+  const size_t                                offset,
+  std::vector< std::pair< size_t, size_t > >  &regions
+  )
+{
+  const unsigned int nTriplets = dustWinLen - 2; // Triplets in a window
+  if ( len < dustWinLen ) return;
+
+  // The score of a window is updated as it slides: adding a triplet that
+  // has been seen c times adds c repeated pairs, removing it takes c - 1
+  uint32_t counts[64] = { 0 };
+  uint64_t nPairs     = 0;
+  auto addTriplet = [&]( const int code )
+    { if ( code >= 0 ) nPairs += counts[ code ]++; };
+  auto removeTriplet = [&]( const int code )
+    { if ( code >= 0 ) nPairs -= --counts[ code ]; };
+
+  for ( unsigned int t = 0; t < nTriplets; t++ )
+    addTriplet( tripletCode( seq + t ) );
+  for ( size_t start = 0; ; start++ )
+  {
+    if ( nPairs > dustThreshold * ( nTriplets - 1 ) )
+    {
+      size_t first = offset + start;
+      size_t last  = first + dustWinLen;
+      if ( !regions.empty() && regions.back().second >= first )
+        regions.back().second = std::max( regions.back().second, last );
+      else
+        regions.push_back( { first, last } );
+    }
+    if ( start + dustWinLen >= len ) break;
+    removeTriplet( tripletCode( seq + start ) );
+    addTriplet( tripletCode( seq + start + nTriplets ) );
+  }
+}
+
+// -----------------------------------------------------------------------------
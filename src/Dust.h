@@ -0,0 +1,39 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+// Dust
+// Ryan D. Crawford
+// 2020/07/27
+// -----------------------------------------------------------------------------
+// Low complexity regions, such as homopolymers and short tandem repeats,
+// are found with a DUST style score. The triplets of bases in a window of
+// the sequence are counted, and the window is scored by how often its
+// triplets repeat: the sum of c * ( c - 1 ) / 2 over the count c of each
+// triplet, divided by the number of triplets in the window less one.
+// Windows that score above the threshold are low complexity. Regions found
+// this way produce many short, repetitive hits that rarely survive as
+// alignments.
+// -----------------------------------------------------------------------------
+
+#ifndef _DUST_
+#define _DUST_
+
+// Length of the windows that are scored, and the score above which a
+// window is low complexity
+const unsigned int dustWinLen    = 64;
+const double       dustThreshold = 20;
+
+// Find the windows of "len" residues at "seq" that are low complexity, and
+// add them to "regions" as zero based, half open intervals offset by
+// "offset". Overlapping windows are merged. Triplets with residues that are
+// not bases are not counted
+void findLowComplexity( const char* seq, const size_t len,
+  const size_t offset, std::vector< std::pair< size_t, size_t > > &regions );
+
+#endif
+
+// -----------------------------------------------------------------------------
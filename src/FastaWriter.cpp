@@ -0,0 +1,124 @@
+#include "FastaWriter.h"
+
+// -----------------------------------------------------------------------------
+// FastaWriter
+// Ryan D. Crawford
+// 2020/06/30
+// -----------------------------------------------------------------------------
+
+// ---- FastaWriter member functions -------------------------------------------
+
+void FastaWriter::addSeq(
+  const BioSeq* seqs, const unsigned int seqIdx, const size_t startPos,
+  const size_t len, const std::string &header
+  )
+{
+  requests.push_back( { seqs, seqIdx, startPos, len, header } );
+}
+
+size_t FastaWriter::nSeqs() const
+{
+  return requests.size();
+}
+
+void FastaWriter::setSoftMask( const bool isSoftMasked )
+{
+  this->isSoftMasked = isSoftMasked;
+}
+
+bool FastaWriter::write( const std::string &faPath )
+{
+  int outFd = open( faPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+  if ( outFd == -1 ) return false;
+  bool isWritten = write( outFd );
+  close( outFd );
+  return isWritten;
+}
+
+bool FastaWriter::write( const int outFd )
+{
+  const size_t bufSize = 1 << 22; // Size of the output buffer
+
+  fd = outFd;
+
+  // Sort the requests so that the genomes are read in order. The requests
+  // are stable sorted by genome, contig and position.
+  std::stable_sort( requests.begin(), requests.end(),
+    []( const SeqRequest &lhs, const SeqRequest &rhs )
+    {
+      if ( lhs.seqs != rhs.seqs )
+        return std::less< const BioSeq* >()( lhs.seqs, rhs.seqs );
+      if ( lhs.seqIdx != rhs.seqIdx ) return lhs.seqIdx < rhs.seqIdx;
+      return lhs.startPos < rhs.startPos;
+    } );
+
+  buf.resize( bufSize );
+  bufLen   = 0;
+  isFailed = false;
+  for ( const auto &req : requests )
+  {
+    // Write the header
+    char* out = reserve( req.header.size() + 2 );
+    out[0] = '>';
+    memcpy( out + 1, req.header.data(), req.header.size() );
+    out[ req.header.size() + 1 ] = '\n';
+    bufLen += req.header.size() + 2;
+
+    // Decode the residues directly into the buffer, one line at a time if
+    // the lines are wrapped, otherwise in blocks as large as the buffer
+    size_t blockLen = lineWidth > 0 ? lineWidth : bufSize / 2;
+    for ( size_t pos = 0; pos < req.len; pos += blockLen )
+    {
+      size_t len = std::min( blockLen, req.len - pos );
+      out = reserve( len + 1 );
+      size_t start = req.startPos + pos;
+      if ( seqCache != nullptr )
+        seqCache->decodeSeq( req.seqs, req.seqIdx, start, len, out );
+      else
+        req.seqs->decodeSeq( req.seqIdx, start, len, out );
+      if ( isSoftMasked )
+        req.seqs->applySoftMask( req.seqIdx, start, len, out );
+      bufLen += len;
+      if ( lineWidth > 0 )
+      {
+        out[ len ] = '\n';
+        bufLen++;
+      }
+    }
+    if ( lineWidth == 0 || req.len == 0 )
+    {
+      out = reserve( 1 );
+      out[0] = '\n';
+      bufLen++;
+    }
+  }
+  flush();
+
+  fd = -1;
+  std::string().swap( buf );
+  return !isFailed;
+}
+
+char* FastaWriter::reserve( const size_t len )
+{
+  if ( bufLen + len > buf.size() )
+  {
+    flush();
+    if ( len > buf.size() ) buf.resize( len );
+  }
+  return &buf[ bufLen ];
+}
+
+void FastaWriter::flush()
+{
+  size_t nWritten = 0;
+  while ( nWritten < bufLen && !isFailed )
+  {
+    ssize_t n = ::write( fd, buf.data() + nWritten, bufLen - nWritten );
+    if ( n <= 0 ) isFailed = true;
+    else nWritten += n;
+  }
+  bufLen = 0;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,105 @@
+#include "BioSeq.h"
+#include "SeqCache.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------
+// FastaWriter
+// Ryan D. Crawford
+// 2020/06/30
+// -----------------------------------------------------------------------------
+// This class writes a multi-fasta file of sequences extracted from genomes.
+// Extraction requests are collected first and sorted by genome and position,
+// so each genome is read in order. The residues are then decoded straight
+// from the genome buffers into a large output buffer, which is written
+// with a single system call each time it fills. Lines can optionally be
+// wrapped at a fixed width. Genomes that are not resident in memory can be
+// read through a cache of decoded windows.
+// -----------------------------------------------------------------------------
+
+#ifndef _FASTA_WRITER_
+#define _FASTA_WRITER_
+class FastaWriter
+{
+public:
+
+  // Ctor: takes the number of residues per line. Zero writes each sequence
+  // on a single line. If "seqCache" is set, residues are read through it
+  FastaWriter( const unsigned int lineWidth = 0, SeqCache* seqCache = nullptr ):
+    lineWidth( lineWidth ), seqCache( seqCache )
+  { ; }
+
+  // Dtor
+  ~FastaWriter()
+  { ; }
+
+  // Request that "len" residues of the contig at "seqIdx" in the genome,
+  // starting at "startPos", are written with the input header
+  void addSeq( const BioSeq* seqs, const unsigned int seqIdx,
+    const size_t startPos, const size_t len, const std::string &header );
+
+  // Write all of the requested sequences to the file at the input path.
+  // Returns false if the file could not be written
+  bool write( const std::string &faPath );
+
+  // Write all of the requested sequences to an open file descriptor, eg a
+  // pipe to another program. The descriptor is not closed
+  bool write( const int outFd );
+
+  // Return the number of sequences that have been requested
+  size_t nSeqs() const;
+
+  // Write the residues that are soft masked or excluded in the genomes in
+  // lower case, and the others in upper case (see "BioSeq::maskSeqs")
+  void setSoftMask( const bool isSoftMasked );
+
+private:
+
+  // A sequence to extract from a genome
+  struct SeqRequest
+  {
+    const BioSeq* seqs;     // Sequences to extract from
+    unsigned int  seqIdx;   // Index of the contig
+    size_t        startPos; // First residue to extract
+    size_t        len;      // Number of residues to extract
+    std::string   header;   // Fasta header, without the ">"
+  };
+
+  // Number of residues per line
+  unsigned int lineWidth;
+
+  // Cache used to read the residues. May be null
+  SeqCache* seqCache;
+
+  // True if the masks of the genomes are applied to the residues
+  bool isSoftMasked = false;
+
+  // Requested sequences
+  std::vector< SeqRequest > requests;
+
+  // Buffer for the output file
+  std::string buf;
+
+  // Number of bytes in the buffer that have not been written
+  size_t bufLen = 0;
+
+  // File descriptor of the output file
+  int fd = -1;
+
+  // True if a write to the file failed
+  bool isFailed = false;
+
+  // Write the contents of the buffer to the file
+  void flush();
+
+  // Reserve space for the input number of bytes in the buffer, flushing it
+  // first if needed. Returns a pointer to the reserved space.
+  char* reserve( const size_t len );
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -1,4 +1,5 @@
 #include "Genome.h"
+#include "Hash.h"
 
 // -----------------------------------------------------------------------------
 // Genome
@@ -10,28 +11,132 @@
 
 bool operator<( const Genome &lhs, const Genome &rhs )
 {
-  if ( lhs.nSeqs() != rhs.nSeqs() ) return lhs.nSeqs() > rhs.nSeqs();
+  if ( lhs.getNumContigs() != rhs.getNumContigs() )
+    return lhs.getNumContigs() > rhs.getNumContigs();
   return lhs.getGenomeSize() < rhs.getGenomeSize();
 }
 
 bool operator>( const Genome &lhs, const Genome &rhs )
 {
-  if ( lhs.nSeqs() != rhs.nSeqs() ) return lhs.nSeqs() < rhs.nSeqs();
+  if ( lhs.getNumContigs() != rhs.getNumContigs() )
+    return lhs.getNumContigs() < rhs.getNumContigs();
   return lhs.getGenomeSize() > rhs.getGenomeSize();
 }
 
 // ---- Member function definitions --------------------------------------------
 
+bool Genome::loadSeqs( const bool lazyLoad, const std::string &cacheDir )
+{
+  // Keep the precomputed statistics to check them against the fasta file
+  bool         isPreset    = isStatsSet;
+  unsigned int presetSize  = genomeSize;
+  unsigned int presetCount = nContigs;
+  if ( lazyLoad )
+  {
+    isLoaded = parseFai();
+  }
+  else if ( cacheDir.empty() || getFasta() == "-" )
+  {
+    isLoaded = parseFasta();
+  }
+  else
+  {
+    // Use the cached genome if it is up to date, otherwise parse the fasta
+    // file and update the cache
+    std::string cachePath = cacheDir + genomeId + ".pgc";
+    isLoaded = readCache( cachePath );
+    if ( !isLoaded )
+    {
+      *this    = Genome( getFasta(), genomeId );
+      isLoaded = parseFasta();
+      if ( isLoaded ) writeCache( cachePath );
+    }
+  }
+  calcStats();
+
+  if ( isLoaded && isPreset &&
+    ( presetSize != genomeSize || presetCount != nContigs ) )
+  {
+    std::cout << "Warning: the size of genome " << genomeId
+              << " does not match the manifest: " << genomeSize << " nts in "
+              << nContigs << " contigs" << std::endl;
+  }
+  return isLoaded;
+}
+
+bool Genome::getIsLoaded() const
+{
+  return isLoaded;
+}
+
+void Genome::setStats( const unsigned int size, const unsigned int contigs )
+{
+  genomeSize = size;
+  nContigs   = contigs;
+  isStatsSet = true;
+}
+
+bool Genome::hasStats() const
+{
+  return isStatsSet || isLoaded;
+}
+
+void Genome::calcStats()
+{
+  // The contigs are stored back to back, so the size of the genome is the
+  // offset of the end of the last contig
+  genomeSize = seqStarts.back();
+  nContigs   = seqNames.size();
+}
+
 unsigned int Genome::getGenomeSize() const
 {
-  // Iterate over each of the contigs. Get the number of residues and add
-  // it to the value to output
-  int genomeSize = 0;
-  for ( auto it = seqs.begin(); it != seqs.end(); it++ )
-    genomeSize += it->size();
   return genomeSize;
 }
 
+unsigned int Genome::getNumContigs() const
+{
+  return nContigs;
+}
+
+void Genome::setSeqIdBase( const uint32_t base )
+{
+  seqIdBase = base;
+}
+
+uint32_t Genome::getSeqIdBase() const
+{
+  return seqIdBase;
+}
+
+bool Genome::getSeqId( const std::string &seqName, uint32_t &seqId ) const
+{
+  unsigned int seqIdx;
+
+  // Names reported by the aligner may still have the prefixes and
+  // descriptions that were removed when the fasta file was parsed
+  if ( !getSeqIndex( seqName, seqIdx ) )
+  {
+    auto start = seqName.find( "accn|" );
+    start      = start == std::string::npos ? 0 : start + 5;
+    auto end   = seqName.find( ' ', start );
+    if ( !getSeqIndex( seqName.substr( start, end - start ), seqIdx ) )
+      return false;
+  }
+  seqId = seqIdBase + seqIdx;
+  return true;
+}
+
+unsigned int Genome::getSeqIdx( const uint32_t seqId ) const
+{
+  return seqId - seqIdBase;
+}
+
+const std::string& Genome::getSeqIdName( const uint32_t seqId ) const
+{
+  return getContigName( getSeqIdx( seqId ) );
+}
+
 std::string Genome::getGenomeName() const
 {
   return genomeId;
@@ -42,4 +147,91 @@ const Genome* Genome::getRef() const
   return this;
 }
 
+void Genome::hashContigs()
+{
+  const size_t blockSize = 1 << 20; // Number of residues decoded at a time
+  std::string  block;
+
+  // The reverse strand is hashed from the last block of the contig back,
+  // so both strands are hashed in blocks of the same residues
+  strandHashes.resize( getNumContigs() );
+  nAmbiguous.assign( getNumContigs(), 0 );
+  for ( unsigned int i = 0; i < getNumContigs(); i++ )
+  {
+    size_t   len = getSeqLen( i );
+    uint64_t fwd = hashCombine( 0, len );
+    uint64_t rev = fwd;
+    for ( size_t pos = 0; pos < len; pos += blockSize )
+    {
+      size_t n = std::min( blockSize, len - pos );
+      block.resize( n );
+      decodeSeq( i, pos, n, &block[0] );
+      for ( auto &c : block )
+      {
+        c = toupper( c );
+        if ( c != 'A' && c != 'C' && c != 'G' && c != 'T' ) nAmbiguous[i]++;
+      }
+      fwd = hashBytes( block.data(), n, fwd );
+
+      // Ambiguity codes are complemented to the code of the complementary
+      // bases. Other residues are their own complement
+      decodeSeq( i, len - pos - n, n, &block[0] );
+      std::reverse( block.begin(), block.end() );
+      for ( auto &c : block )
+      {
+        c = toupper( c );
+        switch ( c )
+        {
+          case 'A': c = 'T'; break;
+          case 'C': c = 'G'; break;
+          case 'G': c = 'C'; break;
+          case 'T': c = 'A'; break;
+          case 'R': c = 'Y'; break;
+          case 'Y': c = 'R'; break;
+          case 'K': c = 'M'; break;
+          case 'M': c = 'K'; break;
+          case 'B': c = 'V'; break;
+          case 'V': c = 'B'; break;
+          case 'D': c = 'H'; break;
+          case 'H': c = 'D'; break;
+          default:  break;
+        }
+      }
+      rev = hashBytes( block.data(), n, rev );
+    }
+    strandHashes[i] = { fwd, rev };
+  }
+}
+
+uint32_t Genome::getNumAmbiguous( const unsigned int seqIdx ) const
+{
+  return seqIdx < nAmbiguous.size() ? nAmbiguous[ seqIdx ] : 0;
+}
+
+uint64_t Genome::getFwdHash( const unsigned int seqIdx ) const
+{
+  return seqIdx < strandHashes.size() ? strandHashes[ seqIdx ].first : 0;
+}
+
+uint64_t Genome::getRevHash( const unsigned int seqIdx ) const
+{
+  return seqIdx < strandHashes.size() ? strandHashes[ seqIdx ].second : 0;
+}
+
+uint64_t Genome::getCanonicalHash( const unsigned int seqIdx ) const
+{
+  return std::min( getFwdHash( seqIdx ), getRevHash( seqIdx ) );
+}
+
+uint64_t Genome::getGenomeHash() const
+{
+  std::vector< uint64_t > hashes;
+  for ( unsigned int i = 0; i < strandHashes.size(); i++ )
+    hashes.push_back( getCanonicalHash( i ) );
+  std::sort( hashes.begin(), hashes.end() );
+  uint64_t hash = hashCombine( 0, hashes.size() );
+  for ( auto h : hashes ) hash = hashCombine( hash, h );
+  return hash;
+}
+
 // -----------------------------------------------------------------------------
@@ -28,10 +28,38 @@ public:
     BioSeq( faPath ), genomeId( genomeId )
   { ; }
 
+  // Copy and move ctors and assignment
+  Genome( const Genome &rhs ) = default;
+  Genome( Genome &&rhs ) = default;
+  Genome& operator=( const Genome &rhs ) = default;
+  Genome& operator=( Genome &&rhs ) = default;
+
   // Default Dtor
   ~Genome()
   { ; }
 
+  // Parse the fasta file, or only its index if "lazyLoad" is true, and
+  // record the size and number of contigs in the genome. If "cacheDir" is
+  // set the parsed genome is read from, or written to, a binary cache file
+  // in that directory.
+  bool loadSeqs( const bool lazyLoad, const std::string &cacheDir = "" );
+
+  // Return true if the sequences of this genome have been loaded
+  bool getIsLoaded() const;
+
+  // Set the size and number of contigs from precomputed values, so that
+  // genomes can be sorted before their fasta files are opened. The values
+  // are replaced when the genome is loaded.
+  void setStats( const unsigned int size, const unsigned int contigs );
+
+  // Return true if the size and number of contigs are known
+  bool hasStats() const;
+
+  // Record the size and number of contigs in the genome. This is called
+  // when the genome is loaded, so the statistics are not recalculated when
+  // the genomes are sorted. Must be called if sequences are added manually.
+  void calcStats();
+
   // Overload the Function to enable sorting of genomes.
   friend bool operator<( const Genome &lhs, const Genome &rhs );
 
@@ -41,14 +69,81 @@ public:
   // Return the number of bps in this genome
   unsigned int getGenomeSize() const;
 
+  // Return the number of contigs in this genome
+  unsigned int getNumContigs() const;
+
+  // Set the first contig id of this genome. The contigs of each genome in
+  // a run are assigned dense, consecutive 32-bit ids so that alignments can
+  // refer to contigs without storing their names.
+  void setSeqIdBase( const uint32_t base );
+
+  // Return the first contig id of this genome
+  uint32_t getSeqIdBase() const;
+
+  // Look up the id of the contig with the input name. Returns false if the
+  // name is not a contig in this genome
+  bool getSeqId( const std::string &seqName, uint32_t &seqId ) const;
+
+  // Return the index in this genome of the contig with the input id
+  unsigned int getSeqIdx( const uint32_t seqId ) const;
+
+  // Return the name of the contig with the input id
+  const std::string& getSeqIdName( const uint32_t seqId ) const;
+
 
   const Genome* getRef() const;
 
+  // Hash the residues of each contig on both strands, ignoring case, and
+  // count the residues that are not bases. Ambiguity codes are hashed as
+  // they are, so contigs that differ only in their ambiguous residues have
+  // different hashes. A contig and its reverse complement have the same
+  // hashes, swapped. This is called when the genome is loaded, while its
+  // sequences are in memory, if duplicates are to be found
+  void hashContigs();
+
+  // Return the number of residues of the contig at the input index that
+  // are not bases. Zero if the contigs have not been hashed
+  uint32_t getNumAmbiguous( const unsigned int seqIdx ) const;
+
+  // Return the hashes of the forward and reverse strands of the contig at
+  // the input index. Zero if the contigs have not been hashed
+  uint64_t getFwdHash( const unsigned int seqIdx ) const;
+  uint64_t getRevHash( const unsigned int seqIdx ) const;
+
+  // Return the smaller of the two hashes of the contig, which is the same
+  // for either strand
+  uint64_t getCanonicalHash( const unsigned int seqIdx ) const;
+
+  // Return a hash of the contigs of the genome, which does not depend on
+  // their names, order or strand
+  uint64_t getGenomeHash() const;
+
 private:
 
   // Name of this genome
   std::string genomeId;
 
+  // Number of bps in this genome
+  unsigned int genomeSize = 0;
+
+  // Number of contigs in this genome
+  unsigned int nContigs = 0;
+
+  // Id of the first contig in this genome
+  uint32_t seqIdBase = 0;
+
+  // True once the sequences, or their index, have been loaded
+  bool isLoaded = false;
+
+  // True if the size and number of contigs were set before loading
+  bool isStatsSet = false;
+
+  // Hashes of the forward and reverse strands of each contig
+  std::vector< std::pair< uint64_t, uint64_t > > strandHashes;
+
+  // Number of residues in each contig that are not bases
+  std::vector< uint32_t > nAmbiguous;
+
 };
 #endif
 
@@ -13,20 +13,121 @@ bool operator>( const Genome &lhs, const Genome &rhs );
 
 // ---- GenomeData Member functions --------------------------------------------
 
-// Value ctor for inputs of gff files, fasta files, and the correspondingw
-// genome names
+// Value ctor for inputs of fasta files, the corresponding genome names and
+// optionally the precomputed size of each genome
 GenomeData::GenomeData(
-  const std::vector< std::string > &faPaths,
-  const std::vector< std::string > &genomeIds
+  const std::vector< std::string >  &faPaths,
+  const std::vector< std::string >  &genomeIds,
+  const std::vector< unsigned int > &genomeSizes,
+  const std::vector< unsigned int > &nContigs
   )
 {
   // Initialize the vector of genome class objects
   genomeData.reserve( faPaths.size() );
   for ( unsigned int i = 0; i < faPaths.size(); i++ )
+  {
     genomeData.push_back( Genome( faPaths[i], genomeIds[i] ) );
 
-  for ( auto it = genomeData.begin(); it != genomeData.end(); it++ )
-    it->parseFasta();
+    // Genomes with a size of zero were not given a size in the manifest
+    if ( i < genomeSizes.size() && i < nContigs.size() && genomeSizes[i] )
+      genomeData.back().setStats( genomeSizes[i], nContigs[i] );
+  }
+}
+
+GenomeData::~GenomeData()
+{
+  if ( !spillDir.empty() )
+  {
+    std::error_code ec;
+    std::filesystem::remove_all( spillDir, ec );
+  }
+}
+
+void GenomeData::setMemBudget(
+  const size_t maxMem, const std::string &spillDir
+  )
+{
+  this->maxMem   = maxMem;
+  this->spillDir = maxMem > 0 ? spillDir : "";
+  if ( !this->spillDir.empty() )
+    std::filesystem::create_directories( this->spillDir );
+}
+
+size_t GenomeData::getMemBudget() const
+{
+  return maxMem;
+}
+
+void GenomeData::releaseGenome( const unsigned int idx )
+{
+  if ( maxMem == 0 || !genomeData[ idx ].isResident() ) return;
+  if ( !genomeData[ idx ].releaseSeqs( spillDir ) )
+  {
+    std::cout << "Warning: unable to release the sequences of "
+              << genomeData[ idx ].getGenomeName() << std::endl;
+  }
+}
+
+size_t GenomeData::getMemUsage() const
+{
+  size_t nBytes = 0;
+  for ( const auto &genome : genomeData ) nBytes += genome.memUsage();
+  return nBytes;
+}
+
+void GenomeData::loadGenomes(
+  const bool         lazyLoad,
+  const unsigned int nThreads,
+  const std::string  &cacheDir,
+  const bool         hashContigs
+  )
+{
+  if ( !cacheDir.empty() ) std::filesystem::create_directories( cacheDir );
+
+  // Parse the fasta files in parallel. The size and number of contigs of
+  // each genome are recorded as it is parsed. If there is a memory budget,
+  // genomes that do not fit in the remaining memory are released as soon as
+  // they are loaded.
+  std::vector< char >   isFailed( genomeData.size(), false );
+  std::atomic< size_t > resident( getMemUsage() );
+  ThreadPool pool( nThreads );
+  for ( unsigned int i = 0; i < genomeData.size(); i++ )
+  {
+    if ( genomeData[i].getIsLoaded() ) continue;
+    Genome* g    = &genomeData[i];
+    char*   fail = &isFailed[i];
+    pool.addJob(
+      [this, g, fail, lazyLoad, &cacheDir, hashContigs, &resident]()
+      {
+        *fail = !g->loadSeqs( lazyLoad, cacheDir );
+        if ( !*fail && hashContigs ) g->hashContigs();
+        if ( *fail || maxMem == 0 || !g->isResident() ) return;
+        size_t nBytes = g->memUsage();
+        if ( resident.fetch_add( nBytes ) + nBytes > maxMem &&
+          g->releaseSeqs( spillDir ) )
+        {
+          resident.fetch_sub( nBytes );
+        }
+      } );
+  }
+  pool.wait();
+
+  for ( unsigned int i = 0; i < genomeData.size(); i++ )
+  {
+    if ( !isFailed[i] ) continue;
+    std::cout << "Unable to load the genome " << genomeData[i].getGenomeName()
+              << " from " << genomeData[i].getFasta() << std::endl;
+    exit( 1 );
+  }
+
+  assignSeqIds();
+}
+
+bool GenomeData::hasGenomeStats() const
+{
+  for ( const auto &genome : genomeData )
+    if ( !genome.hasStats() ) return false;
+  return true;
 }
 
 // Return the gene ids for all of the input genomes
@@ -47,6 +148,13 @@ std::vector< std::string > GenomeData::getGenomeIds()
 void GenomeData::sortGenomes()
 {
   sort( genomeData.begin(), genomeData.end(), std::greater< Genome >() );
+  assignSeqIds();
+
+  // Sketches and duplicates are by the index of the genome, so they no
+  // longer apply
+  sketches.clear();
+  nShared.clear();
+  dupOf.clear();
 
   for ( auto &g : genomeData )
   {
@@ -55,6 +163,286 @@ void GenomeData::sortGenomes()
   }
 }
 
+void GenomeData::maskGenomes(
+  const unsigned int minLen, const unsigned int nThreads
+  )
+{
+  ThreadPool pool( nThreads );
+  for ( auto &genome : genomeData )
+    pool.addJob( [&genome, minLen]() { genome.maskSeqs( minLen ); } );
+  pool.wait();
+
+  size_t nTotal    = 0;
+  size_t nSoft     = 0;
+  size_t nExcluded = 0;
+  for ( const auto &genome : genomeData )
+  {
+    nTotal    += genome.getGenomeSize();
+    nSoft     += genome.getNumSoftMasked();
+    nExcluded += genome.getNumExcluded();
+  }
+  std::cout << "Masked " << nSoft << " low complexity nts and excluded "
+            << nExcluded << " of " << nTotal << " nts from the searches"
+            << std::endl;
+}
+
+bool GenomeData::isMasked() const
+{
+  for ( const auto &genome : genomeData )
+    if ( genome.isMasked() ) return true;
+  return false;
+}
+
+void GenomeData::sketchGenomes(
+  const unsigned int scale, const unsigned int nThreads
+  )
+{
+  unsigned int nGenomes = genomeData.size();
+  ThreadPool   pool( nThreads );
+
+  sketches.assign( nGenomes, Sketch() );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+    pool.addJob( [this, i, scale]()
+      { sketches[i] = Sketch( &genomeData[i], scale ); } );
+  pool.wait();
+
+  // Each job counts the hashes one genome shares with the genomes after it
+  nShared.assign( nGenomes, std::vector< uint32_t >( nGenomes, 0 ) );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    nShared[i][i] = sketches[i].size();
+    pool.addJob( [this, i, nGenomes]()
+      {
+        for ( unsigned int j = i + 1; j < nGenomes; j++ )
+          nShared[i][j] = sketches[i].countShared( sketches[j] );
+      } );
+  }
+  pool.wait();
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+    for ( unsigned int j = 0; j < i; j++ ) nShared[i][j] = nShared[j][i];
+}
+
+bool GenomeData::isSketched() const
+{
+  return !sketches.empty() && sketches.size() == genomeData.size();
+}
+
+uint32_t GenomeData::getNumShared(
+  const unsigned int lhs, const unsigned int rhs
+  ) const
+{
+  return nShared[ lhs ][ rhs ];
+}
+
+double GenomeData::getContainment(
+  const unsigned int idx, const unsigned int ref
+  ) const
+{
+  if ( nShared[ idx ][ idx ] == 0 ) return 0;
+  return double( nShared[ idx ][ ref ] ) / nShared[ idx ][ idx ];
+}
+
+void GenomeData::sortBySimilarity()
+{
+  unsigned int nGenomes = genomeData.size();
+  if ( !isSketched() || nGenomes < 2 ) return;
+
+  // The greatest containment of each genome in a genome that is placed,
+  // and the genome it is contained in
+  std::vector< unsigned int > order   = { 0 };
+  std::vector< char >         isPlaced( nGenomes, false );
+  std::vector< double >       bestCont( nGenomes, 0 );
+  std::vector< unsigned int > bestRef( nGenomes, 0 );
+  isPlaced[0] = true;
+  while ( order.size() < nGenomes )
+  {
+    unsigned int last = order.back();
+    int          next = -1;
+    for ( unsigned int i = 0; i < nGenomes; i++ )
+    {
+      if ( isPlaced[i] ) continue;
+      double cont = getContainment( i, last );
+      if ( cont > bestCont[i] )
+      {
+        bestCont[i] = cont;
+        bestRef[i]  = last;
+      }
+      if ( next == -1 || bestCont[i] > bestCont[ next ] ) next = i;
+    }
+    order.push_back( next );
+    isPlaced[ next ] = true;
+  }
+
+  std::cout << "Genomes ordered by similarity:" << std::endl;
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    std::cout << "Genome: " << genomeData[ order[i] ].getGenomeName();
+    if ( i > 0 && bestCont[ order[i] ] > 0 )
+    {
+      std::cout << " nearest "
+                << genomeData[ bestRef[ order[i] ] ].getGenomeName()
+                << " ANI " << 100 * Sketch::getAni( bestCont[ order[i] ] )
+                << "%";
+    }
+    std::cout << std::endl;
+  }
+
+  // Move the genomes, their sketches and the shared hashes into the order
+  std::vector< Genome >                  sortedGenomes;
+  std::vector< Sketch >                  sortedSketches;
+  std::vector< std::vector< uint32_t > > sortedShared( nGenomes,
+    std::vector< uint32_t >( nGenomes ) );
+  for ( unsigned int i = 0; i < nGenomes; i++ )
+  {
+    sortedGenomes.push_back( std::move( genomeData[ order[i] ] ) );
+    sortedSketches.push_back( std::move( sketches[ order[i] ] ) );
+    for ( unsigned int j = 0; j < nGenomes; j++ )
+      sortedShared[i][j] = nShared[ order[i] ][ order[j] ];
+  }
+  genomeData.swap( sortedGenomes );
+  sketches.swap( sortedSketches );
+  nShared.swap( sortedShared );
+  dupOf.clear();
+  assignSeqIds();
+}
+
+bool GenomeData::writeSketchStats( const std::string &path ) const
+{
+  if ( !isSketched() ) return false;
+  std::ofstream ofs( path.c_str() );
+  if ( !ofs.is_open() ) return false;
+  ofs << "query\tsubject\tshared\tcontainment\tani\n";
+  for ( unsigned int i = 0; i < genomeData.size(); i++ )
+  {
+    for ( unsigned int j = 0; j < genomeData.size(); j++ )
+    {
+      if ( i == j || nShared[i][j] == 0 ) continue;
+      double cont = getContainment( i, j );
+      ofs << genomeData[i].getGenomeName() << '\t'
+          << genomeData[j].getGenomeName() << '\t' << nShared[i][j] << '\t'
+          << cont << '\t' << Sketch::getAni( cont ) << '\n';
+    }
+  }
+  ofs.close();
+  return !ofs.fail();
+}
+
+void GenomeData::findDuplicates()
+{
+  unsigned int nGenomes = genomeData.size();
+  dupOf.resize( nGenomes );
+  dupSeqs.assign( nGenomes, {} );
+  isDupReverse.assign( nGenomes, {} );
+
+  // The first genome with each hash is kept. Later genomes with the same
+  // hash, size and number of contigs are its duplicates
+  std::unordered_map< uint64_t, unsigned int > firstGenome;
+  std::unordered_map< uint64_t, unsigned int > nCopies;
+  unsigned int nDuplicates = 0;
+  unsigned int nCopied     = 0;
+  for ( unsigned int g = 0; g < nGenomes; g++ )
+  {
+    const Genome &genome = genomeData[g];
+    dupOf[g] = firstGenome.emplace( genome.getGenomeHash(), g ).first->second;
+    const Genome &first = genomeData[ dupOf[g] ];
+
+    // Pair each contig with a contig of the first genome that has the same
+    // hash, in order, so repeated contigs are paired one to one
+    bool isPaired = dupOf[g] != g &&
+      first.getGenomeSize() == genome.getGenomeSize() &&
+      first.getNumContigs() == genome.getNumContigs();
+    if ( isPaired )
+    {
+      std::unordered_map< uint64_t, std::vector< unsigned int > > seqsByHash;
+      for ( int i = first.getNumContigs() - 1; i >= 0; i-- )
+        seqsByHash[ first.getCanonicalHash( i ) ].push_back( i );
+      dupSeqs[g].resize( genome.getNumContigs() );
+      isDupReverse[g].resize( genome.getNumContigs() );
+      for ( unsigned int i = 0; isPaired && i < genome.getNumContigs(); i++ )
+      {
+        auto &seqs = seqsByHash[ genome.getCanonicalHash( i ) ];
+        isPaired = !seqs.empty() &&
+          genome.getSeqLen( i ) == first.getSeqLen( seqs.back() );
+        if ( !isPaired ) break;
+        dupSeqs[g][i]      = seqs.back();
+        isDupReverse[g][i] = genome.getFwdHash( i ) !=
+          first.getFwdHash( seqs.back() );
+        seqs.pop_back();
+      }
+    }
+    if ( isPaired )
+    {
+      nDuplicates++;
+      std::cout << "Genome: " << genome.getGenomeName()
+                << " is a duplicate of " << first.getGenomeName() << std::endl;
+      continue;
+    }
+
+    // Genomes that are not duplicates only share some of their contigs
+    dupOf[g] = g;
+    dupSeqs[g].clear();
+    isDupReverse[g].clear();
+    for ( unsigned int i = 0; i < genome.getNumContigs(); i++ )
+      if ( nCopies[ genome.getCanonicalHash( i ) ]++ > 0 ) nCopied++;
+  }
+  std::cout << "Found " << nDuplicates << " duplicate genomes and "
+            << nCopied << " other contigs that are copies of an earlier "
+            << "contig" << std::endl;
+}
+
+unsigned int GenomeData::getDuplicateOf( const unsigned int idx ) const
+{
+  return idx < dupOf.size() ? dupOf[ idx ] : idx;
+}
+
+unsigned int GenomeData::getDuplicateSeq(
+  const unsigned int idx, const unsigned int seqIdx, bool &isReverse
+  ) const
+{
+  isReverse = false;
+  if ( getDuplicateOf( idx ) == idx ) return seqIdx;
+  isReverse = isDupReverse[ idx ][ seqIdx ];
+  return dupSeqs[ idx ][ seqIdx ];
+}
+
+bool GenomeData::writeDuplicates( const std::string &path ) const
+{
+  std::ofstream ofs( path.c_str() );
+  if ( !ofs.is_open() ) return false;
+  ofs << "genome\tcontig\tlength\tcopy_of_genome\tcopy_of_contig\tstrand\n";
+
+  // Duplicate genomes are listed as a whole, and the other contigs by the
+  // first contig with the same hash
+  std::unordered_map< uint64_t, std::pair< unsigned int, unsigned int > >
+    firstSeq;
+  for ( unsigned int g = 0; g < genomeData.size(); g++ )
+  {
+    const Genome &genome = genomeData[g];
+    unsigned int  dup    = getDuplicateOf( g );
+    if ( dup != g )
+    {
+      ofs << genome.getGenomeName() << "\t*\t" << genome.getGenomeSize()
+          << '\t' << genomeData[ dup ].getGenomeName() << "\t*\t.\n";
+      continue;
+    }
+    for ( unsigned int i = 0; i < genome.getNumContigs(); i++ )
+    {
+      auto it = firstSeq.emplace( genome.getCanonicalHash( i ),
+        std::make_pair( g, i ) ).first;
+      if ( it->second.first == g && it->second.second == i ) continue;
+      const Genome &first = genomeData[ it->second.first ];
+      bool isReverse = genome.getFwdHash( i ) !=
+        first.getFwdHash( it->second.second );
+      ofs << genome.getGenomeName() << '\t' << genome.getContigName( i )
+          << '\t' << genome.getSeqLen( i ) << '\t' << first.getGenomeName()
+          << '\t' << first.getContigName( it->second.second ) << '\t'
+          << ( isReverse ? '-' : '+' ) << '\n';
+    }
+  }
+  ofs.close();
+  return !ofs.fail();
+}
+
 // Return the gene ids for all of the input genomes
 std::vector< std::string > GenomeData::getFaPaths()
 {
@@ -81,4 +469,36 @@ const Genome* GenomeData::getGenomeRefAtIdx( const int &idx ) const
   return & genomeData[ idx ];
 }
 
+const Genome* GenomeData::getGenomeRefBySeqId( const uint32_t seqId ) const
+{
+  if ( genomeData.empty() ) return nullptr;
+  return & genomeData[ getGenomeIdxBySeqId( seqId ) ];
+}
+
+unsigned int GenomeData::getGenomeIdxBySeqId( const uint32_t seqId ) const
+{
+  // Find the last genome with a first id that is not after the input id
+  auto it = std::upper_bound( genomeData.begin(), genomeData.end(), seqId,
+    []( const uint32_t id, const Genome &g ) { return id < g.getSeqIdBase(); }
+    );
+  if ( it == genomeData.begin() ) return 0;
+  return it - genomeData.begin() - 1;
+}
+
+uint32_t GenomeData::getNumSeqIds() const
+{
+  if ( genomeData.empty() ) return 0;
+  return genomeData.back().getSeqIdBase() + genomeData.back().getNumContigs();
+}
+
+void GenomeData::assignSeqIds()
+{
+  uint32_t base = 0;
+  for ( auto &genome : genomeData )
+  {
+    genome.setSeqIdBase( base );
+    base += genome.getNumContigs();
+  }
+}
+
 // -----------------------------------------------------------------------------
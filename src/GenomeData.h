@@ -1,7 +1,12 @@
 #include "Genome.h"
+#include "Sketch.h"
+#include "ThreadPool.h"
 #include <vector>
 #include <string>
 #include <iostream>
+#include <filesystem>
+#include <atomic>
+#include <fstream>
 
 // -----------------------------------------------------------------------------
 // GenomeData
@@ -21,9 +26,49 @@ class GenomeData
 {
 public:
 
-  // Ctor: Takes the paths to the fasta files and the id's for each genome 
+  // Ctor: Takes the paths to the fasta files and the id's for each genome.
+  // The fasta files are not opened until the genomes are loaded. If the
+  // sizes and numbers of contigs of the genomes are known, eg from a
+  // manifest, they are used to sort the genomes before they are loaded.
   GenomeData( const std::vector< std::string > &faPaths,
-    const std::vector< std::string > &genomeIds );
+    const std::vector< std::string > &genomeIds,
+    const std::vector< unsigned int > &genomeSizes = {},
+    const std::vector< unsigned int > &nContigs = {} );
+
+  // Dtor: removes the files written when genomes were released
+  ~GenomeData();
+
+  // Limit the memory used by the sequences of the genomes to "maxMem"
+  // bytes. Genomes loaded once the limit is reached are released (see
+  // "BioSeq::releaseSeqs"), as are the genomes passed to "releaseGenome".
+  // Copies of sequences that can not be read randomly are written to
+  // "spillDir". A limit of zero keeps every genome in memory.
+  void setMemBudget( const size_t maxMem, const std::string &spillDir );
+
+  // Return the memory budget in bytes. Zero if there is no limit
+  size_t getMemBudget() const;
+
+  // Release the sequences of the genome at the input index if there is a
+  // memory budget. The sequences are then read from disk when requested
+  void releaseGenome( const unsigned int idx );
+
+  // Return the approximate number of bytes used by the genome sequences
+  size_t getMemUsage() const;
+
+  // Load the genomes that have not been loaded. If "lazyLoad" is true only
+  // the ".fai" indexes of the fasta files are read and sequences are read
+  // from the files when they are requested. Genomes are parsed in parallel
+  // on "nThreads" threads (zero for one thread per core), in the order of
+  // the vector. If "cacheDir" is set, binary caches of the parsed genomes
+  // are used and updated in that directory. If "hashContigs" is set the
+  // contigs are hashed as they are loaded, to find duplicates
+  void loadGenomes( const bool lazyLoad = false,
+    const unsigned int nThreads = 0, const std::string &cacheDir = "",
+    const bool hashContigs = false );
+
+  // Return true if the size and number of contigs are known for every
+  // genome, so the genomes can be sorted without being loaded
+  bool hasGenomeStats() const;
 
   // Return the gene ids for all of the input genomes
   std::vector< std::string > getGenomeIds();
@@ -34,6 +79,69 @@ public:
   // Sort genomes by number of contigs and genome size
   void sortGenomes();
 
+  // Mask the contigs of each genome on "nThreads" threads (zero for one
+  // thread per core), so that the regions that can not hold an alignment of
+  // "minLen" nts are not searched (see "BioSeq::maskSeqs")
+  void maskGenomes( const unsigned int minLen,
+    const unsigned int nThreads = 0 );
+
+  // Return true if the genomes have been masked
+  bool isMasked() const;
+
+  // Compute a sketch of each genome, keeping the hashes in the lowest
+  // 1/"scale" of their range, on "nThreads" threads (zero for one thread
+  // per core). The hashes shared by each pair of genomes are then counted
+  void sketchGenomes( const unsigned int scale,
+    const unsigned int nThreads = 0 );
+
+  // Return true if the genomes have been sketched
+  bool isSketched() const;
+
+  // Return the number of sketch hashes shared by the genomes at the input
+  // indexes. Genomes that share none are unlikely to share an alignment
+  uint32_t getNumShared( const unsigned int lhs,
+    const unsigned int rhs ) const;
+
+  // Return the fraction of the sketch of the genome at "idx" that is found
+  // in the sketch of the genome at "ref"
+  double getContainment( const unsigned int idx,
+    const unsigned int ref ) const;
+
+  // Order the sketched genomes so that related genomes are next to each
+  // other. The first genome is kept, and each following genome is the one
+  // most contained in a genome that is already placed. Ties, and genomes
+  // that share nothing with the genomes placed, keep their current order
+  void sortBySimilarity();
+
+  // Write the number of shared hashes, the containment and the estimated
+  // ANI of each pair of sketched genomes that share hashes to a tab
+  // delimited file. Returns false if the file could not be written
+  bool writeSketchStats( const std::string &path ) const;
+
+  // Find the genomes that are exact duplicates of an earlier genome: they
+  // have the same contigs, in any order and on either strand, as found by
+  // the hashes of the contigs taken when the genomes were loaded. Each
+  // duplicate is recorded with the first genome it duplicates, and each of
+  // its contigs with the identical contig of that genome. Contigs shared by
+  // genomes that are not duplicates are counted and listed by
+  // "writeDuplicates". Must be called again if the genomes are reordered
+  void findDuplicates();
+
+  // Return the index of the genome that the genome at "idx" is a duplicate
+  // of, or "idx" if it is not a duplicate
+  unsigned int getDuplicateOf( const unsigned int idx ) const;
+
+  // Return the index of the contig in the genome returned by
+  // "getDuplicateOf" that is identical to the contig at "seqIdx" of the
+  // genome at "idx". "isReverse" is set if it is the reverse complement
+  unsigned int getDuplicateSeq( const unsigned int idx,
+    const unsigned int seqIdx, bool &isReverse ) const;
+
+  // Write the duplicate genomes, and the contigs that are copies of a
+  // contig of an earlier genome, to a tab delimited file. Returns false if
+  // the file could not be written
+  bool writeDuplicates( const std::string &path ) const;
+
   // Return the number of genomes contained in this object
   unsigned int getNumGenomes() const;
 
@@ -41,11 +149,45 @@ public:
   // vector of genomes
   const Genome* getGenomeRefAtIdx( const int &idx ) const;
 
+  // Return the reference of the genome containing the contig with the
+  // input id
+  const Genome* getGenomeRefBySeqId( const uint32_t seqId ) const;
+
+  // Return the index of the genome containing the contig with the input id
+  unsigned int getGenomeIdxBySeqId( const uint32_t seqId ) const;
+
+  // Return the total number of contigs in all genomes
+  uint32_t getNumSeqIds() const;
+
 private:
 
   // This is a vector of genom class objects
   std::vector< Genome > genomeData;
 
+  // Maximium number of bytes of resident sequences. Zero for no limit
+  size_t maxMem = 0;
+
+  // Directory for the copies of released genomes
+  std::string spillDir;
+
+  // Sketch of each genome, if they have been sketched
+  std::vector< Sketch > sketches;
+
+  // Number of sketch hashes shared by each pair of genomes. The diagonal
+  // is the size of the sketch of the genome
+  std::vector< std::vector< uint32_t > > nShared;
+
+  // Index of the genome each genome duplicates, or its own index, and for
+  // duplicates, the identical contig of that genome for each contig and
+  // whether it is the reverse complement. Empty until duplicates are found
+  std::vector< unsigned int >                 dupOf;
+  std::vector< std::vector< unsigned int > >  dupSeqs;
+  std::vector< std::vector< char > >          isDupReverse;
+
+  // Assign each contig of each genome a dense id, in the order of the
+  // genomes in the vector
+  void assignSeqIds();
+
 };
 #endif
 
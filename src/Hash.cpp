@@ -0,0 +1,72 @@
+#include "Hash.h"
+
+// -----------------------------------------------------------------------------
+// Hash
+// Ryan D. Crawford
+// 2020/06/23
+// -----------------------------------------------------------------------------
+
+// ---- Hash functions ---------------------------------------------------------
+
+uint64_t hashBytes( const void* data, const size_t len, const uint64_t seed )
+{
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int      r = 47;
+
+  const uint8_t* bytes = static_cast< const uint8_t* >( data );
+  uint64_t       h     = seed ^ ( len * m );
+
+  // Mix in eight bytes at a time
+  size_t nWords = len / 8;
+  for ( size_t i = 0; i < nWords; i++ )
+  {
+    uint64_t k;
+    memcpy( &k, bytes + 8 * i, 8 );
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  // Mix in the remaining bytes
+  const uint8_t* tail = bytes + 8 * nWords;
+  switch ( len & 7 )
+  {
+    case 7: h ^= uint64_t( tail[6] ) << 48; [[fallthrough]];
+    case 6: h ^= uint64_t( tail[5] ) << 40; [[fallthrough]];
+    case 5: h ^= uint64_t( tail[4] ) << 32; [[fallthrough]];
+    case 4: h ^= uint64_t( tail[3] ) << 24; [[fallthrough]];
+    case 3: h ^= uint64_t( tail[2] ) << 16; [[fallthrough]];
+    case 2: h ^= uint64_t( tail[1] ) << 8;  [[fallthrough]];
+    case 1: h ^= uint64_t( tail[0] );
+            h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+uint64_t hashString( const std::string &str, const uint64_t seed )
+{
+  return hashBytes( str.data(), str.size(), seed );
+}
+
+uint64_t hashCombine( const uint64_t lhs, const uint64_t rhs )
+{
+  uint64_t pair[2] = { lhs, rhs };
+  return hashBytes( pair, sizeof( pair ) );
+}
+
+std::string hashToHex( const uint64_t hash )
+{
+  const char digits[] = "0123456789abcdef";
+  std::string hex( 16, '0' );
+  for ( int i = 0; i < 16; i++ )
+    hex[ 15 - i ] = digits[ ( hash >> ( 4 * i ) ) & 15 ];
+  return hex;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,34 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// -----------------------------------------------------------------------------
+// Hash
+// Ryan D. Crawford
+// 2020/06/23
+// -----------------------------------------------------------------------------
+// Non-cryptographic 64-bit hash functions used to fingerprint sequences and
+// files. Data is consumed eight bytes at a time (MurmurHash64A), and hashes
+// can be chained by passing the previous hash as the seed.
+// -----------------------------------------------------------------------------
+
+#ifndef _HASH_
+#define _HASH_
+
+// Hash "len" bytes starting at "data"
+uint64_t hashBytes( const void* data, const size_t len,
+  const uint64_t seed = 0 );
+
+// Hash the contents of a string
+uint64_t hashString( const std::string &str, const uint64_t seed = 0 );
+
+// Combine two hashes. The result depends on the order of the arguments
+uint64_t hashCombine( const uint64_t lhs, const uint64_t rhs );
+
+// Format a hash as a string of 16 hexadecimal digits
+std::string hashToHex( const uint64_t hash );
+
+#endif
+
+// -----------------------------------------------------------------------------
@@ -20,23 +20,58 @@ InputParser::InputParser ( int argc, char *argv[] )
     exit( 0 );
   }
 
-  // Get the directory with the fasta files
-  if ( !getOption( "--fastaDir", fastaDir ) )
+  // Genomes are read from a manifest, the fasta directory or both
+  string manifest;
+  bool   isManifest = getOption( "--manifest", manifest );
+  bool   isFastaDir = getOption( "--fastaDir", fastaDir );
+  if ( !isManifest && !isFastaDir )
   {
-    cout << "Missing reqired argument: --fastaDir" << endl;
+    cout << "Missing reqired argument: --fastaDir or --manifest" << endl;
     exit( 1 );
   }
 
   // Get the directory with the fasta files
   if ( !getOption( "--fastaExt", fastaExt ) ) fastaExt = ".fasta";
 
-  // Get the paths to the input files
-  getPaths( fastaDir, fastaFiles, fastaExt );
+  if ( isManifest ) parseManifest( manifest );
+
+  if ( isFastaDir )
+  {
+    // Get the paths to the input files
+    vector< string > dirFiles;
+    getPaths( fastaDir, dirFiles, fastaExt );
+
+    // Set the genome Ids
+    for ( const auto & fa : dirFiles )
+    {
+      fastaFiles.push_back( fa );
+      genomeIds.push_back( getGenomeId( fa, fastaExt ) );
+    }
+  }
+
+  // A genome piped on stdin is added to the genomes from the fasta directory
+  string stdinId;
+  if ( getOption( "--stdinId", stdinId ) )
+  {
+    fastaFiles.push_back( "-" );
+    genomeIds.push_back( stdinId );
+  }
+
+  // The genome ids name the genomes in the results, so each genome in the
+  // manifest and the fasta directory must have its own
+  unordered_set< string > uniqueIds;
+  for ( const auto &genomeId : genomeIds )
+  {
+    if ( uniqueIds.insert( genomeId ).second ) continue;
+    cout << "The genome id " << genomeId << " was input more than once. "
+         << "The genomes in the manifest and the fasta directory must have "
+         << "unique ids" << endl;
+    exit( 1 );
+  }
 
-  // Set the genome Ids
-  genomeIds.reserve( fastaFiles.size() );
-  for ( const auto & fa : fastaFiles )
-    genomeIds.push_back( getGenomeId( fa, fastaExt ) );
+  // Genomes that were not in the manifest do not have a size
+  genomeSizes.resize( fastaFiles.size(), 0 );
+  genomeContigs.resize( fastaFiles.size(), 0 );
 
   if ( fastaFiles.size() <=1 )
   {
@@ -85,23 +120,191 @@ InputParser::InputParser ( int argc, char *argv[] )
    } else {
      minLen = stoi( val );
    }
+
+  lazyLoad  = findOption( "--lazy" );
+  keepTsv   = findOption( "--keepTsv" );
+  isBatched = findOption( "--batch" );
+  isGreedy  = findOption( "--greedy" );
+
+  if ( !getOption( "--threads", val ) )
+  {
+    nThreads = 0;
+  } else {
+    nThreads = stoi( val );
+  }
+
+  // Parsed genomes are cached in the output directory unless a directory is
+  // given. The cache can be disabled with "--cacheDir none"
+  if ( !getOption( "--cacheDir", cacheDir ) )
+  {
+    cacheDir = outDir + "genome_cache/";
+  }
+  else if ( cacheDir == "none" )
+  {
+    cacheDir = "";
+  }
+  else if ( cacheDir.back() != '/' )
+  {
+    cacheDir = cacheDir + '/';
+  }
+
+  // Blast databases and hits are cached in the output directory unless a
+  // directory is given. The cache can be disabled with "--blastCache none"
+  if ( !getOption( "--blastCache", blastCacheDir ) )
+  {
+    blastCacheDir = outDir + "blast_cache/";
+  }
+  else if ( blastCacheDir == "none" )
+  {
+    blastCacheDir = "";
+  }
+  else if ( blastCacheDir.back() != '/' )
+  {
+    blastCacheDir = blastCacheDir + '/';
+  }
+
+  if ( !getOption( "--aligner", aligner ) ) aligner = "blast";
+  if ( !getOption( "--pafCmd", pafCmd ) ) pafCmd = "minimap2 -c -x asm5";
+
+  if ( !getOption( "--chunkSize", val ) )
+  {
+    chunkSize = 0;
+  } else {
+    chunkSize = std::stoull( val );
+  }
+
+  if ( !getOption( "--chunkOverlap", val ) )
+  {
+    chunkOverlap = 10000;
+  } else {
+    chunkOverlap = std::stoull( val );
+  }
+
+  isSketched = !findOption( "--noSketch" );
+  if ( !getOption( "--sketchScale", val ) )
+  {
+    sketchScale = 0;
+  } else {
+    sketchScale = stoi( val );
+  }
+
+  isMasked = !findOption( "--noMask" );
+  isDeduped = !findOption( "--noDedup" );
+
+  // Workers run the searches queued in the work directory by the
+  // coordinator
+  if ( getOption( "--workDir", workDir ) && workDir.back() != '/' )
+    workDir = workDir + '/';
+  isWorker = findOption( "--worker" );
+  if ( isWorker && workDir.empty() )
+  {
+    cout << "Argument --worker requires --workDir" << endl;
+    exit( 1 );
+  }
+
+  // The memory budget is input in megabytes
+  if ( !getOption( "--maxMem", val ) )
+  {
+    maxMem = 0;
+  } else {
+    maxMem = std::stoull( val ) << 20;
+  }
+
+  if ( !getOption( "--mergeGroups", val ) )
+  {
+    mergeGroups = 1;
+  } else {
+    mergeGroups = std::max( stoi( val ), 1 );
+  }
+
+  if ( !getOption( "--lineWidth", val ) )
+  {
+    lineWidth = 0;
+  } else {
+    lineWidth = stoi( val );
+  }
 }
 
 void InputParser::printOptions()
 {
-  cout << endl << "Required arguments:" << endl
+  cout << endl << "Required arguments (one or both):" << endl
        << "  --fastaDir Directory containing fasta files to compare"  << endl
+       << "  --manifest Tab delimited file with a genome id and the path to "
+       << "its fasta file on each line, optionally followed by the genome "
+       << "size and number of contigs" << endl
        << endl << "Optional arguments:" << endl
        << "  --minIdent Minimium identity to collapse alignment to "
        << "(range 0-100) Defaults to 99%" << endl
        << "  --outDir   Directory to write files."
        << "defaults to current working directory"  << endl
-       << "  --fastaExt Extension for the fasta files. Defaults to .fasta"
+       << "  --fastaExt Extension for the fasta files. Defaults to .fasta. "
+       << "Files with this extension followed by .gz are also read" << endl
+       << "  --stdinId  Read an additional genome from stdin with this id"
        << endl
        << "  --runId    String to prepend to the output files"  << endl
        << "  --minLen   Minimium length of the alignments to keep. Defaults to "
        << "500 nts."
-       << endl << endl;
+       << endl
+       << "  --lazy     Index the fasta files (.fai) and read sequences only "
+       << "when they are written" << endl
+       << "  --threads  Number of threads used to parse the genomes and run "
+       << "the blast jobs. Defaults to one per core"
+       << endl
+       << "  --cacheDir Directory for binary caches of the parsed genomes. "
+       << "Defaults to genome_cache/ in the output directory. Use \"none\" "
+       << "to disable" << endl
+       << "  --blastCache Directory for the blast databases and results, "
+       << "which are reused by later runs on genomes with the same contents. "
+       << "Defaults to blast_cache/ in the output directory. Use \"none\" to "
+       << "disable" << endl
+       << "  --batch    Blast each genome once against the combined databases "
+       << "of the genomes after it, rather than once per pair" << endl
+       << "  --greedy   Add the genomes to a pan-genome one at a time. Each "
+       << "genome is only searched against the regions of the earlier genomes "
+       << "that were new to the pan-genome, and only adds its own new "
+       << "regions. Faster than comparing every pair, but alignments are only "
+       << "found to the first genome with the region" << endl
+       << "  --aligner  Aligner used to compare the genomes: blast, paf (an "
+       << "external aligner with PAF output) or internal (a seed and extend "
+       << "aligner for high identity alignments that runs without external "
+       << "programs). Defaults to blast" << endl
+       << "  --pafCmd   Command used to run the paf aligner. Defaults to "
+       << "\"minimap2 -c -x asm5\"" << endl
+       << "  --chunkSize Split query genomes into windows of this many nts, "
+       << "searched as separate jobs. Alignments cut at the seams of the "
+       << "windows are joined. By default queries are not split" << endl
+       << "  --chunkOverlap Overlap between the windows of a contig. Defaults "
+       << "to 10000 nts" << endl
+       << "  --noSketch Compare every pair of genomes, rather than skipping "
+       << "pairs that share no hashes in their sketches" << endl
+       << "  --sketchScale Keep one in this many k-mers in the sketches of the "
+       << "genomes. Defaults to a scale at which an alignment of the minimum "
+       << "length and identity is all but certain to share a hash" << endl
+       << "  --noMask   Search the whole genomes, rather than excluding "
+       << "contigs, runs of N's and pieces between them that are shorter than "
+       << "the minimum length, and masking low complexity regions so that "
+       << "they do not seed alignments" << endl
+       << "  --noDedup  Search every genome, rather than copying the hits of "
+       << "genomes that are exact duplicates of an earlier genome from the "
+       << "genome they duplicate" << endl
+       << "  --workDir  Shared directory the searches are queued in. They "
+       << "are run by this process and by any workers started with --worker "
+       << "on nodes that share the directory" << endl
+       << "  --worker   Run the searches queued in --workDir by another "
+       << "process, then exit. The genomes and search options must be the "
+       << "same as those of that process" << endl
+       << "  --keepTsv  Write the blast output to blast_results/ in the output "
+       << "directory for debugging" << endl
+       << "  --maxMem   Memory budget for the genome sequences in MB. Genomes "
+       << "are read from disk once they are aligned. The indexes of the "
+       << "internal aligner are held to the same budget, and are loaded "
+       << "again if they are released before their last search. Defaults "
+       << "to no limit" << endl
+       << "  --mergeGroups Split the genomes into this many groups, find "
+       << "the unique alignments of each group in parallel and merge the "
+       << "groups in a tree. Defaults to 1 (a single pass)" << endl
+       << "  --lineWidth Wrap the output sequences at this many residues. "
+       << "Defaults to 0 (no wrapping)" << endl << endl;
 }
 
 void InputParser::printArgs()
@@ -152,15 +355,98 @@ void InputParser::getPaths(
   fs::recursive_directory_iterator it = fs::recursive_directory_iterator( dir );
   for ( const auto & dirEntry : it )
   {
-    if ( findExt( dirEntry.path(), ext ) ) paths.push_back( dirEntry.path() );
+    // Gzip compressed files with the same extension are also included
+    if ( findExt( dirEntry.path(), ext ) ||
+      findExt( dirEntry.path(), ext + ".gz" ) )
+    {
+      paths.push_back( dirEntry.path() );
+    }
   }
 }
 
 string InputParser::getGenomeId( string fa, string ext )
 {
   int start = fa.find_last_of( "/" ) + 1;
-  int len   = fa.find( ext ) - start;
+  int len   = fa.rfind( ext ) - start;
   return fa.substr( start, len );
 }
 
+bool InputParser::parseCount( const string &field, unsigned int &val )
+{
+  if ( field.empty() || field.size() > 10 ||
+    field.find_first_not_of( "0123456789" ) != string::npos )
+  {
+    return false;
+  }
+  unsigned long n = stoul( field );
+  if ( n == 0 || n > UINT32_MAX ) return false;
+  val = n;
+  return true;
+}
+
+void InputParser::parseManifest( const string &manifestPath )
+{
+  ifstream ifs( manifestPath );
+  if ( ifs.fail() || !ifs.is_open() )
+  {
+    cout << "Unable to open the manifest: " << manifestPath << endl;
+    exit( 1 );
+  }
+
+  // Relative paths in the manifest are relative to its directory
+  fs::path manifestDir = fs::path( manifestPath ).parent_path();
+
+  string       line;
+  unsigned int lineNum = 0;
+  while ( getline( ifs, line ) )
+  {
+    lineNum++;
+
+    // Skip empty lines and comments
+    if ( !line.empty() && line.back() == '\r' ) line.pop_back();
+    if ( line.empty() || line[0] == '#' ) continue;
+
+    // Split the line on tabs
+    vector< string > fields;
+    stringstream     ss( line );
+    string           field;
+    while ( getline( ss, field, '\t' ) ) fields.push_back( field );
+
+    if ( fields.size() != 2 && fields.size() != 4 )
+    {
+      cout << "Line " << lineNum << " of the manifest must have 2 or 4 "
+           << "tab delimited fields: genome id, fasta path, genome size and "
+           << "number of contigs" << endl;
+      exit( 1 );
+    }
+
+    fs::path faPath( fields[1] );
+    if ( faPath.is_relative() && fields[1] != "-" )
+      faPath = manifestDir / faPath;
+
+    genomeIds.push_back( fields[0] );
+    fastaFiles.push_back( faPath.string() );
+    if ( fields.size() == 4 )
+    {
+      // The size and number of contigs must be positive integers. A header
+      // line without a "#" fails here
+      unsigned int size;
+      unsigned int nContigs;
+      if ( !parseCount( fields[2], size ) ||
+        !parseCount( fields[3], nContigs ) )
+      {
+        cout << "Line " << lineNum << " of the manifest has a genome size "
+             << "or number of contigs that is not a positive integer: "
+             << fields[2] << ", " << fields[3] << endl;
+        exit( 1 );
+      }
+      genomeSizes.push_back( size );
+      genomeContigs.push_back( nContigs );
+    } else {
+      genomeSizes.push_back( 0 );
+      genomeContigs.push_back( 0 );
+    }
+  }
+}
+
 // -----------------------------------------------------------------------------
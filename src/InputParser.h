@@ -2,7 +2,10 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <unordered_set>
 #include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <stdlib.h>
 
 // -----------------------------------------------------------------------------
@@ -28,6 +31,11 @@ public:
   // Vector with the genome Ids
   std::vector< std::string > genomeIds;
 
+  // Size and number of contigs of each genome from the manifest. Zero if
+  // the values were not given
+  std::vector< unsigned int > genomeSizes;
+  std::vector< unsigned int > genomeContigs;
+
   // Directory to write temp files
   std::string outDir;
 
@@ -43,6 +51,70 @@ public:
   // Minimium lenth of alignment to keep
   unsigned int minLen;
 
+  // Read sequences from the fasta files only when they are needed
+  bool lazyLoad;
+
+  // Number of threads to use. Zero uses one thread per core
+  unsigned int nThreads;
+
+  // Directory with the binary caches of the parsed genomes
+  std::string cacheDir;
+
+  // Directory with the blast databases and hits shared between runs
+  std::string blastCacheDir;
+
+  // Maximium number of bytes of genome sequences to hold in memory. Zero
+  // for no limit
+  size_t maxMem;
+
+  // Keep the blast output in the output directory for debugging
+  bool keepTsv;
+
+  // Blast each query against all of its subjects in a single search
+  bool isBatched;
+
+  // Search each genome only against the sequences of the earlier genomes
+  // that are not yet in the pan-genome, rather than against every genome
+  bool isGreedy;
+
+  // Name of the aligner used to compare the genomes, and the command used
+  // to run the aligner of the "paf" backend
+  std::string aligner;
+  std::string pafCmd;
+
+  // Size of the windows query genomes are split into, and the overlap
+  // between them. A size of zero does not split the queries
+  size_t chunkSize;
+  size_t chunkOverlap;
+
+  // Sketch the genomes to skip pairs that share no sketch hashes and to
+  // order related genomes together, and the scale of the sketches. A
+  // scale of zero is chosen from the minimum length and identity
+  bool         isSketched;
+  unsigned int sketchScale;
+
+  // Shared directory the searches are queued in, or empty to run them in
+  // this process only, and whether this process only runs the searches
+  // queued by another process
+  std::string workDir;
+  bool        isWorker;
+
+  // Mask the genomes before searching them: regions that can not hold an
+  // alignment are excluded and low complexity regions do not seed
+  bool isMasked;
+
+  // Copy the hits of genomes that are exact duplicates of an earlier genome
+  // rather than searching them
+  bool isDeduped;
+
+  // Number of groups of genomes whose unique alignments are found in
+  // parallel and then merged in a tree. One for a single pass
+  unsigned int mergeGroups;
+
+  // Number of residues per line in the output fasta file. Zero for no
+  // line wrapping
+  unsigned int lineWidth;
+
   // Print out the
   void printArgs();
 
@@ -71,6 +143,15 @@ private:
   // Extract genome name from path
   std::string getGenomeId( std::string fa, std::string ext );
 
+  // Read the genome ids, fasta paths and optionally the size and number of
+  // contigs of each genome from a tab delimited manifest file. Exits with
+  // the line number if a line can not be parsed
+  void parseManifest( const std::string &manifestPath );
+
+  // Parse a positive integer field of the manifest. Returns false if the
+  // field is not a positive integer that fits in "val"
+  bool parseCount( const std::string &field, unsigned int &val );
+
   // Directory wih the fasta files
   std::string fastaDir;
 
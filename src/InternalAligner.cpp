@@ -0,0 +1,895 @@
+#include "InternalAligner.h"
+namespace fs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+// InternalAligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+
+// ---- InternalAligner member functions ---------------------------------------
+
+InternalAligner::InternalAligner( const unsigned int minLen ):
+  minLen( minLen )
+{ ; }
+
+std::string InternalAligner::getVersion()
+{
+  return "pearl internal aligner 3, exact matches, minimizer chain and "
+    "extend";
+}
+
+std::string InternalAligner::getParams() const
+{
+  return "kmerLen " + std::to_string( kmerLen ) + " winLen " +
+    std::to_string( winLen ) + " probeLen " + std::to_string( probeLen ) +
+    " minLen " + std::to_string( minLen );
+}
+
+bool InternalAligner::canCombine() const
+{
+  return true;
+}
+
+bool InternalAligner::indexRanges(
+  const Genome* genome, const std::vector< SeqRange > &ranges,
+  const std::string &idxPath
+  )
+{
+  FastaWriter writer( 80 );
+  for ( const auto &range : ranges )
+    writer.addSeq( genome, range.seqIdx, range.startPos, range.len,
+      range.name );
+  return writer.write( idxPath + ".fa" );
+}
+
+bool InternalAligner::combineIndexes(
+  const std::vector< std::string > &idxPaths, const std::string &outPath
+  )
+{
+  std::ofstream ofs( ( outPath + ".lst" ).c_str() );
+  if ( !ofs.is_open() ) return false;
+  for ( const auto &idxPath : idxPaths ) ofs << idxPath << '\n';
+  ofs.close();
+  return !ofs.fail();
+}
+
+void InternalAligner::releaseIndex( const std::string &idxPath )
+{
+  std::lock_guard< std::mutex > lock( idxMutex );
+  indexes.erase( idxPath );
+}
+
+void InternalAligner::setMemBudget( const size_t maxMem )
+{
+  this->maxMem = maxMem;
+}
+
+bool InternalAligner::search(
+  const Genome*                               query,
+  const std::vector< SeqRange >*              ranges,
+  const std::string                           &idxPath,
+  const uint32_t                              /* nSubjSeqs */,
+  const std::function< void( AlignRecord& ) > &onHit
+  )
+{
+  std::shared_ptr< IndexEntry > entry = getIndex( idxPath );
+  if ( !entry->isOk ) return false;
+
+  std::vector< SeqRange > genomeRanges;
+  if ( ranges == nullptr ) genomeRanges = getGenomeRanges( query );
+  for ( const auto &range : ranges != nullptr ? *ranges : genomeRanges )
+  {
+    // Search both strands of the query. The seeds of masked queries are
+    // taken from a copy with the masked residues replaced by N's
+    std::string seq( range.len, '\0' );
+    std::string seedSeq;
+    query->decodeSeq( range.seqIdx, range.startPos, range.len, &seq[0] );
+    if ( query->isMasked() )
+    {
+      query->applySoftMask( range.seqIdx, range.startPos, range.len,
+        &seq[0] );
+      seedSeq = seq;
+      for ( auto &c : seedSeq ) if ( islower( c ) ) c = 'N';
+    }
+    for ( auto &c : seq ) c = toupper( c );
+    const std::string &seeds = seedSeq.empty() ? seq : seedSeq;
+    for ( const auto &idx : entry->parts )
+      alignSeq( seq, seeds, range.name, false, *idx, onHit );
+
+    auto revComp = []( std::string &str )
+      {
+        std::reverse( str.begin(), str.end() );
+        for ( auto &c : str )
+        {
+          switch ( c )
+          {
+            case 'A': c = 'T'; break;
+            case 'C': c = 'G'; break;
+            case 'G': c = 'C'; break;
+            case 'T': c = 'A'; break;
+            default:  c = 'N'; break;
+          }
+        }
+      };
+    revComp( seq );
+    if ( !seedSeq.empty() ) revComp( seedSeq );
+    for ( const auto &idx : entry->parts )
+      alignSeq( seq, seeds, range.name, true, *idx, onHit );
+  }
+  return true;
+}
+
+std::shared_ptr< InternalAligner::IndexEntry > InternalAligner::getIndex(
+  const std::string &idxPath
+  )
+{
+  std::shared_ptr< IndexEntry > entry;
+  {
+    std::lock_guard< std::mutex > lock( idxMutex );
+    auto &ptr = indexes[ idxPath ];
+    if ( ptr == nullptr ) ptr = std::make_shared< IndexEntry >();
+    entry = ptr;
+  }
+  bool isLoaded = false;
+  std::call_once( entry->isLoaded, [this, &idxPath, &entry, &isLoaded]()
+    {
+      entry->isOk = loadIndex( idxPath, *entry );
+      isLoaded    = true;
+    } );
+  if ( isLoaded ) enforceMemBudget();
+  return entry;
+}
+
+bool InternalAligner::loadIndex(
+  const std::string &idxPath, IndexEntry &entry
+  )
+{
+  // A combined index lists the paths to the indexes of its genomes, which
+  // are loaded once and shared by every combined index that lists them
+  if ( fs::exists( idxPath + ".lst" ) )
+  {
+    std::ifstream ifs( ( idxPath + ".lst" ).c_str() );
+    std::string   line;
+    while ( getline( ifs, line ) )
+    {
+      if ( line.empty() ) continue;
+      std::shared_ptr< IndexEntry > genome = getIndex( line );
+      if ( !genome->isOk ) return false;
+      entry.parts.insert( entry.parts.end(), genome->parts.begin(),
+        genome->parts.end() );
+    }
+    return true;
+  }
+
+  // The fasta file is checked first, since the parser exits if it can not
+  // be opened
+  BioSeq seqs( idxPath + ".fa" );
+  if ( !fs::exists( idxPath + ".fa" ) || !seqs.parseFasta() )
+  {
+    std::cout << "Unable to read the index " << idxPath << ".fa"
+              << std::endl;
+    return false;
+  }
+  // Positions in the suffix arrays are 32 bit, so the contigs of a genome
+  // that do not fit are split between several indexes, which are searched
+  // in turn. A contig that is too long by itself is only seeded with
+  // minimizers
+  std::vector< std::string > contigs = seqs.getSeqs();
+  std::shared_ptr< SubjIndex > idx;
+  for ( unsigned int i = 0; i < contigs.size(); i++ )
+  {
+    if ( idx != nullptr &&
+      idx->text.size() + contigs[i].size() + 1 > maxTextLen )
+    {
+      indexContigs( *idx );
+      entry.parts.push_back( idx );
+      idx = nullptr;
+    }
+    if ( idx == nullptr ) idx = std::make_shared< SubjIndex >();
+    idx->names.push_back( seqs.getContigName( i ) );
+    idx->starts.push_back( idx->text.size() );
+    idx->text += contigs[i];
+    idx->text += '$';
+    std::string().swap( contigs[i] );
+  }
+  if ( idx != nullptr )
+  {
+    indexContigs( *idx );
+    entry.parts.push_back( idx );
+  }
+  if ( entry.parts.size() > 1 )
+    std::cout << "The index " << idxPath << " is split into "
+              << entry.parts.size() << " parts that fit in the suffix array"
+              << std::endl;
+  return true;
+}
+
+void InternalAligner::indexContigs( SubjIndex &idx ) const
+{
+  for ( auto &c : idx.text ) c = toupper( c );
+  for ( size_t i = 0; i < idx.starts.size(); i++ )
+  {
+    size_t end = i + 1 < idx.starts.size() ? idx.starts[ i + 1 ] :
+      idx.text.size();
+    idx.seqs.push_back( std::string_view( idx.text ).substr( idx.starts[i],
+      end - idx.starts[i] - 1 ) );
+  }
+
+  if ( idx.text.size() <= maxTextLen )
+    buildSuffixArray( idx.text, idx.sufArray );
+  else
+    std::cout << "Warning: the contig " << idx.names[0] << " is too long "
+              << "for the suffix array. Its exact matches are only found "
+              << "from the minimizers" << std::endl;
+
+  // Index the minimizers of each contig
+  std::vector< std::pair< uint64_t, uint32_t > > mins;
+  for ( uint32_t s = 0; s < idx.seqs.size(); s++ )
+  {
+    getMinimizers( idx.seqs[s], mins );
+    for ( const auto &m : mins )
+      idx.seeds.push_back( { m.first, s, m.second } );
+  }
+  std::sort( idx.seeds.begin(), idx.seeds.end(),
+    []( const Seed &lhs, const Seed &rhs )
+    {
+      if ( lhs.hash != rhs.hash ) return lhs.hash < rhs.hash;
+      if ( lhs.seqIdx != rhs.seqIdx ) return lhs.seqIdx < rhs.seqIdx;
+      return lhs.pos < rhs.pos;
+    } );
+  idx.nBytes = idx.text.size() + idx.seeds.size() * sizeof( Seed ) +
+    idx.sufArray.size() * sizeof( uint32_t ) +
+    idx.starts.size() * ( sizeof( size_t ) + sizeof( std::string_view ) );
+}
+
+void InternalAligner::enforceMemBudget()
+{
+  if ( maxMem == 0 ) return;
+  std::lock_guard< std::mutex > lock( idxMutex );
+
+  // Indexes of genomes that are shared by combined indexes are counted once
+  std::unordered_map< const SubjIndex*, size_t > loaded;
+  for ( const auto &idx : indexes )
+    for ( const auto &part : idx.second->parts )
+      loaded.emplace( part.get(), part->nBytes );
+  size_t nBytes = 0;
+  for ( const auto &part : loaded ) nBytes += part.second;
+
+  // An entry is only held by this map if no search, or combined index that
+  // is being loaded, is using it. The memory of a genome is freed with the
+  // last entry that holds it
+  for ( auto it = indexes.begin(); it != indexes.end() && nBytes > maxMem; )
+  {
+    if ( it->second.use_count() > 1 )
+    {
+      it++;
+      continue;
+    }
+    for ( const auto &part : it->second->parts )
+      if ( part.use_count() == 1 ) nBytes -= part->nBytes;
+    it = indexes.erase( it );
+  }
+}
+
+void InternalAligner::getMinimizers(
+  const std::string_view                         seq,
+  std::vector< std::pair< uint64_t, uint32_t > > &mins
+  )
+{
+  const uint64_t mask = ( uint64_t( 1 ) << ( 2 * kmerLen ) ) - 1;
+
+  // The k-mers of the current window that may still be its minimizer, in
+  // order of their position. Their hashes are increasing, so the first is
+  // the minimizer. Ties are broken by the first position
+  std::deque< std::pair< uint64_t, uint32_t > > win;
+
+  uint64_t kmer    = 0;
+  size_t   nBase   = 0; // Number of consecutive bases ending at "pos"
+  uint32_t lastPos = UINT32_MAX;
+  mins.clear();
+  for ( size_t pos = 0; pos < seq.size(); pos++ )
+  {
+    int code = baseCode( seq[ pos ] );
+    if ( code < 0 )
+    {
+      nBase = 0;
+      win.clear();
+      continue;
+    }
+    kmer = ( ( kmer << 2 ) | code ) & mask;
+    if ( ++nBase < kmerLen ) continue;
+
+    uint32_t kPos = pos + 1 - kmerLen;
+    uint64_t hash = hashKmer( kmer );
+    while ( !win.empty() && win.back().first > hash ) win.pop_back();
+    win.push_back( { hash, kPos } );
+    while ( win.front().second + winLen <= kPos ) win.pop_front();
+    if ( nBase < kmerLen + winLen - 1 ) continue;
+
+    // Each minimizer is added once, though it is the minimizer of
+    // consecutive windows
+    if ( win.front().second != lastPos )
+    {
+      mins.push_back( win.front() );
+      lastPos = win.front().second;
+    }
+  }
+}
+
+void InternalAligner::buildSuffixArray(
+  const std::string &text, std::vector< uint32_t > &sufArray
+  )
+{
+  const size_t n = text.size();
+  std::vector< uint32_t > ranks( n );
+  std::vector< uint32_t > newRanks( n );
+  std::vector< uint32_t > order( n );
+
+  // Number the characters of the text in order, leaving zero for the end
+  // of the text
+  std::vector< uint32_t > charCodes( 256, 0 );
+  for ( const auto c : text ) charCodes[ uint8_t( c ) ] = 1;
+  uint32_t nChars = 0;
+  for ( auto &code : charCodes ) if ( code != 0 ) code = ++nChars;
+
+  // The first round sorts the suffixes by as many characters as fit in a
+  // key with fewer values than the text has characters, which saves the
+  // first few rounds of doubling
+  size_t   nFirst = 1;
+  uint64_t nKeys  = nChars + 1;
+  while ( nKeys * ( nChars + 1 ) <= std::max( n, size_t( 1 ) << 16 ) )
+  {
+    nKeys *= nChars + 1;
+    nFirst++;
+  }
+  for ( size_t i = 0; i < n; i++ )
+  {
+    uint64_t key = 0;
+    for ( size_t j = 0; j < nFirst; j++ )
+    {
+      key = key * ( nChars + 1 ) +
+        ( i + j < n ? charCodes[ uint8_t( text[ i + j ] ) ] : 0 );
+    }
+    ranks[i] = key;
+  }
+  std::vector< uint32_t > counts( std::max( n, size_t( nKeys ) ) + 1 );
+
+  // Sort the suffixes by the first key, then rank them
+  sufArray.resize( n );
+  for ( size_t i = 0; i < n; i++ ) counts[ ranks[i] + 1 ]++;
+  for ( size_t i = 1; i < counts.size(); i++ ) counts[i] += counts[ i - 1 ];
+  for ( size_t i = 0; i < n; i++ ) sufArray[ counts[ ranks[i] ]++ ] = i;
+  if ( n == 0 ) return;
+  newRanks[ sufArray[0] ] = 0;
+  for ( size_t i = 1; i < n; i++ )
+  {
+    newRanks[ sufArray[i] ] = newRanks[ sufArray[ i - 1 ] ] +
+      ( ranks[ sufArray[i] ] != ranks[ sufArray[ i - 1 ] ] );
+  }
+  ranks.swap( newRanks );
+
+  // Each round sorts the suffixes by twice as many characters, using the
+  // ranks of the previous round as the keys. The suffixes are ordered by
+  // the rank "k" characters on, then stably by their own rank
+  for ( size_t k = nFirst; k < n && ranks[ sufArray[ n - 1 ] ] < n - 1;
+    k *= 2 )
+  {
+    size_t nOrder = 0;
+    for ( size_t i = n - k; i < n; i++ ) order[ nOrder++ ] = i;
+    for ( size_t i = 0; i < n; i++ )
+      if ( sufArray[i] >= k ) order[ nOrder++ ] = sufArray[i] - k;
+
+    std::fill( counts.begin(), counts.end(), 0 );
+    for ( size_t i = 0; i < n; i++ ) counts[ ranks[i] + 1 ]++;
+    for ( size_t i = 1; i < counts.size(); i++ ) counts[i] += counts[ i - 1 ];
+    for ( size_t i = 0; i < n; i++ )
+      sufArray[ counts[ ranks[ order[i] ] ]++ ] = order[i];
+
+    // Suffixes have the same rank if both of their keys are equal
+    auto getKey = [&]( const size_t pos ) -> int64_t
+      { return pos + k < n ? ranks[ pos + k ] : -1; };
+    newRanks[ sufArray[0] ] = 0;
+    for ( size_t i = 1; i < n; i++ )
+    {
+      bool isNew = ranks[ sufArray[i] ] != ranks[ sufArray[ i - 1 ] ] ||
+        getKey( sufArray[i] ) != getKey( sufArray[ i - 1 ] );
+      newRanks[ sufArray[i] ] = newRanks[ sufArray[ i - 1 ] ] + isNew;
+    }
+    ranks.swap( newRanks );
+  }
+}
+
+void InternalAligner::findExactMatches(
+  const std::string     &qSeq,
+  const SubjIndex       &idx,
+  std::vector< Anchor > &anchors
+  ) const
+{
+  if ( idx.sufArray.empty() || qSeq.size() < minLen ) return;
+
+  // Every exact match of "minLen" nts contains a probe that starts at a
+  // multiple of the step
+  const size_t len  = std::min( minLen, probeLen );
+  const size_t step = minLen - len + 1;
+
+  // The end of the last match found on each diagonal of each subject
+  // contig, so that a match that contains several probes is extended once
+  std::unordered_map< uint64_t, size_t > diagEnds;
+
+  for ( size_t qPos = 0; qPos + len <= qSeq.size(); qPos += step )
+  {
+    std::string_view probe = std::string_view( qSeq ).substr( qPos, len );
+    if ( std::any_of( probe.begin(), probe.end(),
+      []( const char c ) { return baseCode( c ) < 0; } ) )
+    {
+      continue;
+    }
+
+    // Find the suffixes that start with the probe
+    auto first = std::lower_bound( idx.sufArray.begin(), idx.sufArray.end(),
+      probe, [&idx, len]( const uint32_t pos, const std::string_view val )
+      { return idx.text.compare( pos, len, val ) < 0; } );
+    auto last = std::upper_bound( first, idx.sufArray.end(), probe,
+      [&idx, len]( const std::string_view val, const uint32_t pos )
+      { return idx.text.compare( pos, len, val ) > 0; } );
+    if ( last - first > maxOcc ) continue;
+
+    for ( auto it = first; it != last; it++ )
+    {
+      uint32_t seqIdx = std::upper_bound( idx.starts.begin(),
+        idx.starts.end(), *it ) - idx.starts.begin() - 1;
+      std::string_view sSeq = idx.seqs[ seqIdx ];
+      size_t   sPos   = *it - idx.starts[ seqIdx ];
+      int64_t  offset = int64_t( sPos ) - int64_t( qPos );
+      uint64_t diag   = ( uint64_t( seqIdx ) << 40 ) ^
+        uint64_t( offset + ( int64_t( 1 ) << 39 ) );
+      auto diagIt = diagEnds.find( diag );
+      if ( diagIt != diagEnds.end() && qPos < diagIt->second ) continue;
+
+      // Extend the probe in both directions while the residues match
+      size_t qStart = qPos;
+      size_t sStart = sPos;
+      while ( qStart > 0 && sStart > 0 && qSeq[ qStart - 1 ] ==
+        sSeq[ sStart - 1 ] && baseCode( qSeq[ qStart - 1 ] ) >= 0 )
+      {
+        qStart--;
+        sStart--;
+      }
+      size_t qEnd = qPos + len;
+      size_t sEnd = sPos + len;
+      while ( qEnd < qSeq.size() && sEnd < sSeq.size() &&
+        qSeq[ qEnd ] == sSeq[ sEnd ] && baseCode( qSeq[ qEnd ] ) >= 0 )
+      {
+        qEnd++;
+        sEnd++;
+      }
+      diagEnds[ diag ] = qEnd;
+      if ( qEnd - qStart < minLen ) continue;
+      anchors.push_back( { seqIdx, uint32_t( qStart ), uint32_t( sStart ),
+        uint32_t( qEnd - qStart ) } );
+    }
+  }
+}
+
+void InternalAligner::alignSeq(
+  const std::string                           &qSeq,
+  const std::string                           &seedSeq,
+  const std::string                           &qName,
+  const bool                                  isReverse,
+  const SubjIndex                             &idx,
+  const std::function< void( AlignRecord& ) > &onHit
+  ) const
+{
+  // Find the exact matches first. Only the parts of the query that are not
+  // covered by an exact match are seeded with minimizers, so the regions
+  // that are shared exactly are not seeded again
+  std::vector< Anchor > anchors;
+  findExactMatches( seedSeq, idx, anchors );
+
+  // Find the parts of the query that are not covered by an exact match
+  std::vector< std::pair< size_t, size_t > > covered;
+  for ( const auto &anchor : anchors )
+    covered.push_back( { anchor.qPos, anchor.qPos + anchor.len } );
+  std::sort( covered.begin(), covered.end() );
+  std::vector< std::pair< size_t, size_t > > gaps;
+  size_t coveredEnd = 0;
+  for ( const auto &range : covered )
+  {
+    if ( range.first > coveredEnd )
+      gaps.push_back( { coveredEnd, range.first } );
+    coveredEnd = std::max( coveredEnd, range.second );
+  }
+  if ( coveredEnd < qSeq.size() ) gaps.push_back( { coveredEnd, qSeq.size() } );
+
+  // Find the minimizers of the gaps, including the windows that overlap
+  // their ends, and keep those with a k-mer that is in a gap
+  const size_t margin = kmerLen + winLen - 1;
+  std::vector< std::pair< uint64_t, uint32_t > > mins;
+  std::vector< std::pair< uint64_t, uint32_t > > gapMins;
+  for ( const auto &gap : gaps )
+  {
+    size_t start = gap.first > margin ? gap.first - margin : 0;
+    size_t end   = std::min( gap.second + margin, qSeq.size() );
+    getMinimizers( std::string_view( seedSeq ).substr( start, end - start ),
+      gapMins );
+    for ( auto &m : gapMins )
+    {
+      m.second += start;
+      if ( m.second < gap.second && m.second + kmerLen > gap.first )
+        mins.push_back( m );
+    }
+  }
+
+  // Add the anchors from the minimizers. Minimizers found from two gaps
+  // are only used once
+  std::sort( mins.begin(), mins.end(),
+    []( const std::pair< uint64_t, uint32_t > &lhs,
+      const std::pair< uint64_t, uint32_t > &rhs )
+    { return lhs.second < rhs.second; } );
+  mins.erase( std::unique( mins.begin(), mins.end() ), mins.end() );
+  for ( const auto &m : mins )
+  {
+    auto range = std::equal_range( idx.seeds.begin(), idx.seeds.end(),
+      Seed{ m.first, 0, 0 },
+      []( const Seed &lhs, const Seed &rhs ) { return lhs.hash < rhs.hash; } );
+    if ( range.second - range.first > maxOcc ) continue;
+    for ( auto it = range.first; it != range.second; it++ )
+      anchors.push_back( { it->seqIdx, m.second, it->pos, kmerLen } );
+  }
+  std::sort( anchors.begin(), anchors.end(),
+    []( const Anchor &lhs, const Anchor &rhs )
+    {
+      if ( lhs.seqIdx != rhs.seqIdx ) return lhs.seqIdx < rhs.seqIdx;
+      if ( lhs.qPos != rhs.qPos ) return lhs.qPos < rhs.qPos;
+      return lhs.sPos < rhs.sPos;
+    } );
+
+  // Align around each chain. The alignments are kept with the index of
+  // their subject contig so they can be reported in order
+  std::vector< std::pair< uint32_t, AlignRecord > > hits;
+  std::vector< AlignRecord > recs;
+  for ( const auto &chain : chainAnchors( anchors ) )
+  {
+    uint32_t seqIdx = anchors[ chain[0] ].seqIdx;
+    recs.clear();
+    extendChain( qSeq, idx.seqs[ seqIdx ], anchors, chain, recs );
+    for ( auto &rec : recs ) hits.push_back( { seqIdx, std::move( rec ) } );
+  }
+  std::sort( hits.begin(), hits.end(),
+    []( const std::pair< uint32_t, AlignRecord > &lhs,
+      const std::pair< uint32_t, AlignRecord > &rhs )
+    {
+      const AlignRecord &l = lhs.second;
+      const AlignRecord &r = rhs.second;
+      if ( lhs.first != rhs.first ) return lhs.first < rhs.first;
+      if ( l.qStart != r.qStart ) return l.qStart < r.qStart;
+      if ( l.sStart != r.sStart ) return l.sStart < r.sStart;
+      if ( l.qEnd != r.qEnd ) return l.qEnd < r.qEnd;
+      return l.sEnd < r.sEnd;
+    } );
+
+  for ( size_t i = 0; i < hits.size(); i++ )
+  {
+    // Chains that are extended into the same alignment are reported once
+    AlignRecord &rec = hits[i].second;
+    if ( i > 0 && hits[ i - 1 ].first == hits[i].first )
+    {
+      const AlignRecord &prev = hits[ i - 1 ].second;
+      if ( prev.qStart == rec.qStart && prev.qEnd == rec.qEnd &&
+        prev.sStart == rec.sStart && prev.sEnd == rec.sEnd )
+      {
+        continue;
+      }
+    }
+
+    // Alignments of the reverse complement are reported on the forward
+    // strand of the query, with the subject positions reversed. Positions
+    // are converted to one based, inclusive positions
+    AlignRecord out = rec;
+    out.qName = qName;
+    out.sName = idx.names[ hits[i].first ];
+    if ( isReverse )
+    {
+      out.qStart = qSeq.size() - rec.qEnd + 1;
+      out.qEnd   = qSeq.size() - rec.qStart;
+      out.sStart = rec.sEnd;
+      out.sEnd   = rec.sStart + 1;
+    } else {
+      out.qStart = rec.qStart + 1;
+      out.sStart = rec.sStart + 1;
+    }
+    onHit( out );
+  }
+}
+
+std::vector< std::vector< unsigned int > > InternalAligner::chainAnchors(
+  const std::vector< Anchor > &anchors
+  ) const
+{
+  // Find the best scoring chain ending at each anchor. An anchor can follow
+  // an earlier anchor of the same contig that is close to it on both
+  // sequences and close to its diagonal. The score is the number of bases
+  // covered by the anchors, less the difference in their diagonals
+  std::vector< int64_t > scores( anchors.size() );
+  std::vector< int64_t > preds( anchors.size() );
+  for ( size_t i = 0; i < anchors.size(); i++ )
+  {
+    const Anchor &cur = anchors[i];
+    scores[i] = cur.len;
+    preds[i]  = -1;
+    size_t first = i > maxLookback ? i - maxLookback : 0;
+    for ( size_t j = i; j-- > first; )
+    {
+      const Anchor &prev = anchors[j];
+      if ( prev.seqIdx != cur.seqIdx ) break;
+      if ( prev.qPos == cur.qPos || prev.sPos >= cur.sPos ) continue;
+      int64_t gapQ = int64_t( cur.qPos ) - prev.qPos - prev.len;
+      int64_t gapS = int64_t( cur.sPos ) - prev.sPos - prev.len;
+      int64_t dd   = std::abs( gapQ - gapS );
+      if ( gapQ > maxGap || gapS > maxGap || dd > maxIndel ) continue;
+      int64_t gain = std::min( std::min( gapQ, gapS ), int64_t( 0 ) ) +
+        cur.len;
+      if ( gain <= 0 ) continue;
+      int64_t score = scores[j] + gain - dd;
+      if ( score > scores[i] )
+      {
+        scores[i] = score;
+        preds[i]  = j;
+      }
+    }
+  }
+
+  // Take the chains from the best scoring anchors, stopping at anchors
+  // that are already part of a better chain
+  std::vector< unsigned int > order( anchors.size() );
+  for ( unsigned int i = 0; i < order.size(); i++ ) order[i] = i;
+  std::stable_sort( order.begin(), order.end(),
+    [&scores]( const unsigned int lhs, const unsigned int rhs )
+    { return scores[ lhs ] > scores[ rhs ]; } );
+
+  std::vector< std::vector< unsigned int > > chains;
+  std::vector< bool > isUsed( anchors.size(), false );
+  for ( auto i : order )
+  {
+    if ( isUsed[i] ) continue;
+    std::vector< unsigned int > chain;
+    for ( int64_t j = i; j != -1 && !isUsed[j]; j = preds[j] )
+    {
+      chain.push_back( j );
+      isUsed[j] = true;
+    }
+    std::reverse( chain.begin(), chain.end() );
+    chains.push_back( std::move( chain ) );
+  }
+  return chains;
+}
+
+void InternalAligner::extendChain(
+  const std::string                 &qSeq,
+  const std::string_view            sSeq,
+  const std::vector< Anchor >       &anchors,
+  const std::vector< unsigned int > &chain,
+  std::vector< AlignRecord >        &recs
+  ) const
+{
+  AlignStats stats;
+  size_t     qStart;
+  size_t     sStart;
+  size_t     qEnd;
+  size_t     sEnd;
+
+  // Start an alignment at an anchor
+  auto startAt = [&]( const Anchor &anchor )
+  {
+    qStart        = anchor.qPos;
+    sStart        = anchor.sPos;
+    qEnd          = qStart + anchor.len;
+    sEnd          = sStart + anchor.len;
+    stats         = AlignStats();
+    stats.score   = anchor.len * matchScore;
+    stats.matches = anchor.len;
+    stats.columns = anchor.len;
+  };
+
+  // Extend the ends of the alignment and keep it if it is long enough
+  auto finish = [&]()
+  {
+    size_t nLeft  = extendEnd( qSeq, qStart, sSeq, sStart, false, stats );
+    size_t nRight = extendEnd( qSeq, qEnd, sSeq, sEnd, true, stats );
+    if ( stats.columns < minLen ) return;
+    AlignRecord rec;
+    rec.qStart = qStart - nLeft;
+    rec.qEnd   = qEnd + nRight;
+    rec.sStart = sStart - nLeft;
+    rec.sEnd   = sEnd + nRight;
+    rec.length = stats.columns;
+    rec.pIdent = 100.0 * stats.matches / stats.columns;
+    recs.push_back( rec );
+  };
+
+  startAt( anchors[ chain[0] ] );
+  for ( size_t i = 1; i < chain.size(); i++ )
+  {
+    const Anchor &anchor = anchors[ chain[i] ];
+
+    // Anchors that overlap the alignment are only used if they are on the
+    // same diagonal, where they extend the exact match
+    if ( anchor.qPos < qEnd || anchor.sPos < sEnd )
+    {
+      if ( anchor.sPos + qEnd == anchor.qPos + sEnd &&
+        anchor.qPos + anchor.len > qEnd )
+      {
+        uint32_t nNew  = anchor.qPos + anchor.len - qEnd;
+        stats.score   += nNew * matchScore;
+        stats.matches += nNew;
+        stats.columns += nNew;
+        qEnd          += nNew;
+        sEnd          += nNew;
+      }
+      continue;
+    }
+
+    // Align the gap to the anchor, or split the chain if the sequences
+    // between them are too different
+    AlignStats gap = alignGap( &qSeq[ qEnd ], anchor.qPos - qEnd,
+      &sSeq[ sEnd ], anchor.sPos - sEnd );
+    if ( gap.score < minGapScore )
+    {
+      finish();
+      startAt( anchor );
+      continue;
+    }
+    stats.score   += gap.score + anchor.len * matchScore;
+    stats.matches += gap.matches + anchor.len;
+    stats.columns += gap.columns + anchor.len;
+    qEnd           = anchor.qPos + anchor.len;
+    sEnd           = anchor.sPos + anchor.len;
+  }
+  finish();
+}
+
+size_t InternalAligner::extendEnd(
+  const std::string      &qSeq,
+  size_t                 qPos,
+  const std::string_view sSeq,
+  size_t                 sPos,
+  const bool             isForward,
+  AlignStats             &stats
+  )
+{
+  int      score       = 0;
+  int      bestScore   = 0;
+  size_t   len         = 0;
+  size_t   bestLen     = 0;
+  uint32_t matches     = 0;
+  uint32_t bestMatches = 0;
+  while ( true )
+  {
+    char q;
+    char s;
+    if ( isForward )
+    {
+      if ( qPos + len >= qSeq.size() || sPos + len >= sSeq.size() ) break;
+      q = qSeq[ qPos + len ];
+      s = sSeq[ sPos + len ];
+    } else {
+      if ( len >= qPos || len >= sPos ) break;
+      q = qSeq[ qPos - len - 1 ];
+      s = sSeq[ sPos - len - 1 ];
+    }
+    len++;
+
+    if ( q == s && baseCode( q ) >= 0 )
+    {
+      score += matchScore;
+      matches++;
+    } else {
+      score += mismatchScore;
+    }
+    if ( score > bestScore )
+    {
+      bestScore   = score;
+      bestLen     = len;
+      bestMatches = matches;
+    } else if ( bestScore - score > xDrop ) {
+      break;
+    }
+  }
+  stats.score   += bestScore;
+  stats.matches += bestMatches;
+  stats.columns += bestLen;
+  return bestLen;
+}
+
+InternalAligner::AlignStats InternalAligner::alignGap(
+  const char*  qSeq,
+  const size_t qLen,
+  const char*  sSeq,
+  const size_t sLen
+  )
+{
+  // The cells of the alignment are indexed by the row and the diagonal,
+  // which is the column less the row. Only the diagonals between the
+  // start and the end of the gap are aligned, with a margin for indels
+  const int     margin = 8;
+  const int64_t endDiag = int64_t( sLen ) - int64_t( qLen );
+  const int64_t minDiag = std::min( int64_t( 0 ), endDiag ) - margin;
+  const int64_t maxDiag = std::max( int64_t( 0 ), endDiag ) + margin;
+  const size_t  width   = maxDiag - minDiag + 1;
+  const int     minScore = INT_MIN / 2;
+
+  std::vector< AlignStats > cells( ( qLen + 1 ) * width );
+  auto getCell = [&]( const size_t row, const int64_t diag ) -> AlignStats&
+    { return cells[ row * width + ( diag - minDiag ) ]; };
+
+  // Keep the best scoring path into each cell, or the path with the most
+  // identical columns if the scores are tied
+  auto update = [&]( AlignStats &cell, const AlignStats &prev,
+    const int score, const bool isMatch )
+  {
+    if ( prev.score == minScore ) return;
+    int newScore = prev.score + score;
+    if ( newScore > cell.score ||
+      ( newScore == cell.score && prev.matches + isMatch > cell.matches ) )
+    {
+      cell.score   = newScore;
+      cell.matches = prev.matches + isMatch;
+      cell.columns = prev.columns + 1;
+    }
+  };
+
+  for ( size_t i = 0; i <= qLen; i++ )
+  {
+    for ( int64_t d = minDiag; d <= maxDiag; d++ )
+    {
+      AlignStats &cell = getCell( i, d );
+      int64_t     j    = int64_t( i ) + d;
+      cell.score = minScore;
+      if ( j < 0 || j > int64_t( sLen ) ) continue;
+      if ( i == 0 && j == 0 )
+      {
+        cell = AlignStats();
+        continue;
+      }
+      if ( i > 0 && j > 0 )
+      {
+        bool isMatch = qSeq[ i - 1 ] == sSeq[ j - 1 ] &&
+          baseCode( qSeq[ i - 1 ] ) >= 0;
+        update( cell, getCell( i - 1, d ),
+          isMatch ? matchScore : mismatchScore, isMatch );
+      }
+      if ( i > 0 && d < maxDiag ) update( cell, getCell( i - 1, d + 1 ),
+        gapScore, false );
+      if ( d > minDiag ) update( cell, getCell( i, d - 1 ), gapScore, false );
+    }
+  }
+  return getCell( qLen, endDiag );
+}
+
+int InternalAligner::baseCode( const char c )
+{
+  switch ( c )
+  {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default:  return -1;
+  }
+}
+
+uint64_t InternalAligner::hashKmer( uint64_t kmer )
+{
+  const uint64_t mask = ( uint64_t( 1 ) << ( 2 * kmerLen ) ) - 1;
+  kmer = ( ~kmer + ( kmer << 21 ) ) & mask;
+  kmer = kmer ^ kmer >> 24;
+  kmer = ( ( kmer + ( kmer << 3 ) ) + ( kmer << 8 ) ) & mask;
+  kmer = kmer ^ kmer >> 14;
+  kmer = ( ( kmer + ( kmer << 2 ) ) + ( kmer << 4 ) ) & mask;
+  kmer = kmer ^ kmer >> 28;
+  kmer = ( kmer + ( kmer << 31 ) ) & mask;
+  return kmer;
+}
+
+// -----------------------------------------------------------------------------
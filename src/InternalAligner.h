@@ -0,0 +1,251 @@
+#include "Aligner.h"
+#include <mutex>
+#include <deque>
+#include <climits>
+#include <string_view>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
+
+// -----------------------------------------------------------------------------
+// InternalAligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+// This class is an aligner that runs in process, without any external
+// programs. It is tuned for the long, high identity alignments that pearl
+// keeps rather than for sensitivity. Closely related genomes share long
+// exact matches, so these are found first from a suffix array of the
+// subject contigs: every maximal exact match of at least "minLen" nts is
+// an anchor. The rest of the query is seeded by the minimizers of the
+// subjects: the k-mer with the smallest hash in each window of
+// consecutive k-mers. The anchors are chained by dynamic programming along
+// the diagonals of the subject contig. Only the gaps between the anchors
+// of a chain are aligned, with a banded global alignment, and the ends of
+// the chain are extended until the score drops. Both strands of the query
+// are searched.
+// Alignments of at least "minLen" nts are reported with their identity,
+// which counts gaps as differences as blastn does. The results are
+// deterministic. The index of a genome is a fasta file of its contigs,
+// which is loaded and indexed the first time it is searched. A combined
+// index shares the loaded indexes of its genomes, which are searched in
+// turn. Loaded indexes are kept until they are released, or until they
+// exceed the memory budget and are not being searched.
+// -----------------------------------------------------------------------------
+
+#ifndef _INTERNAL_ALIGNER_
+#define _INTERNAL_ALIGNER_
+class InternalAligner: public Aligner
+{
+public:
+
+  // Ctor: takes the length of the shortest alignment to report
+  InternalAligner( const unsigned int minLen );
+
+  // Dtor
+  ~InternalAligner()
+  { ; }
+
+  std::string getVersion();
+
+  std::string getParams() const;
+
+  bool canCombine() const;
+
+  // Write the ranges of the genome to "<idxPath>.fa"
+  bool indexRanges( const Genome* genome,
+    const std::vector< SeqRange > &ranges, const std::string &idxPath );
+
+  // Write the paths of the indexes to "<outPath>.lst"
+  bool combineIndexes( const std::vector< std::string > &idxPaths,
+    const std::string &outPath );
+
+  // Remove the index from the loaded indexes. Searches that are using it
+  // keep it until they finish
+  void releaseIndex( const std::string &idxPath );
+
+  // Limit the memory used by the loaded indexes to "maxMem" bytes. Indexes
+  // that are not being searched are released once the limit is exceeded,
+  // and loaded again if they are searched again. Zero is no limit
+  void setMemBudget( const size_t maxMem );
+
+  bool search( const Genome* query, const std::vector< SeqRange >* ranges,
+    const std::string &idxPath, const uint32_t nSubjSeqs,
+    const std::function< void( AlignRecord& ) > &onHit );
+
+private:
+
+  // Length of the k-mers and number of consecutive k-mers in the windows
+  // the minimizers are chosen from
+  static constexpr unsigned int kmerLen = 19;
+  static constexpr unsigned int winLen  = 10;
+
+  // Length of the probes looked up in the suffix array. Probes are taken
+  // from the query at a step that places one within every exact match of
+  // "minLen" nts
+  static constexpr unsigned int probeLen = 32;
+
+  // Longest text of the contigs of an index, including their separators,
+  // that the 32 bit positions of the suffix array can hold
+  static constexpr size_t maxTextLen = UINT32_MAX - 1;
+
+  // Minimizers and probes found more often than this in an index are not
+  // used as anchors, since they are repeats
+  static constexpr unsigned int maxOcc = 500;
+
+  // Largest distance between consecutive anchors of a chain, and largest
+  // difference in the diagonals of consecutive anchors
+  static constexpr unsigned int maxGap   = 1000;
+  static constexpr unsigned int maxIndel = 64;
+
+  // Number of preceding anchors considered when chaining an anchor
+  static constexpr unsigned int maxLookback = 50;
+
+  // Scores used to extend and align the gaps between the anchors. The
+  // extension of an end stops once the score drops "xDrop" below the best
+  // score. A chain is split at a gap that scores less than "minGapScore"
+  static constexpr int matchScore    = 1;
+  static constexpr int mismatchScore = -3;
+  static constexpr int gapScore      = -2;
+  static constexpr int xDrop         = 30;
+  static constexpr int minGapScore   = -50;
+
+  // Length of the shortest alignment to report
+  unsigned int minLen;
+
+  // A minimizer of a subject contig
+  struct Seed
+  {
+    uint64_t hash;   // Hash of the k-mer
+    uint32_t seqIdx; // Index of the contig in the index
+    uint32_t pos;    // Position of the k-mer in the contig
+  };
+
+  // An exact match between the query and a subject contig: a minimizer or
+  // a maximal exact match
+  struct Anchor
+  {
+    uint32_t seqIdx; // Index of the subject contig
+    uint32_t qPos;   // Position of the match in the query
+    uint32_t sPos;   // Position of the match in the subject
+    uint32_t len;    // Length of the match
+  };
+
+  // Counts of the columns of an alignment
+  struct AlignStats
+  {
+    int      score   = 0;
+    uint32_t matches = 0; // Number of identical columns
+    uint32_t columns = 0; // Number of columns, including gaps
+  };
+
+  // The contigs of a subject genome, their minimizers sorted by their
+  // hash, and the suffix array of the contigs. The contigs are stored in a
+  // single text, separated by a character that is not a base
+  struct SubjIndex
+  {
+    std::vector< std::string >      names;
+    std::string                     text;
+    std::vector< size_t >           starts;
+    std::vector< std::string_view > seqs;
+    std::vector< Seed >             seeds;
+    std::vector< uint32_t >         sufArray;
+    size_t                          nBytes = 0; // Memory used by the index
+  };
+
+  // An index that is loaded by the first search that uses it: the index of
+  // a genome, or the indexes of the genomes of a combined index
+  struct IndexEntry
+  {
+    std::once_flag                                    isLoaded;
+    bool                                              isOk = false;
+    std::vector< std::shared_ptr< const SubjIndex > > parts;
+  };
+
+  // Indexes that have been loaded, by their path
+  std::unordered_map< std::string, std::shared_ptr< IndexEntry > > indexes;
+
+  // Memory budget of the loaded indexes in bytes. Zero is no limit
+  size_t maxMem = 0;
+
+  // Protects "indexes"
+  std::mutex idxMutex;
+
+  // Return the index at the input path, loading it if needed. The index is
+  // not released while the entry is held
+  std::shared_ptr< IndexEntry > getIndex( const std::string &idxPath );
+
+  // Load the index at the input path: the indexes listed by a combined
+  // index, or the contigs of a genome. The contigs of a genome are split
+  // between several indexes if they do not fit in one suffix array.
+  // Returns false if a fasta file of the index could not be read
+  bool loadIndex( const std::string &idxPath, IndexEntry &entry );
+
+  // Find the contigs in the text of the index, their minimizers and the
+  // suffix array of the text
+  void indexContigs( SubjIndex &idx ) const;
+
+  // Release the loaded indexes that are not being searched until the
+  // indexes fit in the memory budget
+  void enforceMemBudget();
+
+  // Find the minimizers of a sequence as pairs of their hash and position.
+  // K-mers with residues that are not bases are skipped
+  static void getMinimizers( const std::string_view seq,
+    std::vector< std::pair< uint64_t, uint32_t > > &mins );
+
+  // Build the suffix array of a text of less than 2^32 characters by prefix
+  // doubling, with a radix sort of the ranks in each round
+  static void buildSuffixArray( const std::string &text,
+    std::vector< uint32_t > &sufArray );
+
+  // Find the maximal exact matches of at least "minLen" nts between a query
+  // sequence and the index, and add them to "anchors"
+  void findExactMatches( const std::string &qSeq, const SubjIndex &idx,
+    std::vector< Anchor > &anchors ) const;
+
+  // Align a query sequence against the index and report the alignments.
+  // The anchors are found from "seedSeq", which is the query with any
+  // masked residues replaced by N's. If "isReverse" is true the sequence is
+  // the reverse complement of the query, and the positions are reported on
+  // the forward strand
+  void alignSeq( const std::string &qSeq, const std::string &seedSeq,
+    const std::string &qName, const bool isReverse, const SubjIndex &idx,
+    const std::function< void( AlignRecord& ) > &onHit ) const;
+
+  // Chain the anchors, which are sorted by subject contig and query
+  // position. Returns the chains, best scoring first, each with the indexes
+  // of its anchors in order
+  std::vector< std::vector< unsigned int > > chainAnchors(
+    const std::vector< Anchor > &anchors ) const;
+
+  // Align the sequences around a chain of anchors. Alignments of at least
+  // "minLen" nts are added to "recs" with zero based, half open positions
+  void extendChain( const std::string &qSeq, const std::string_view sSeq,
+    const std::vector< Anchor > &anchors,
+    const std::vector< unsigned int > &chain,
+    std::vector< AlignRecord > &recs ) const;
+
+  // Extend an alignment from the input positions without gaps, forwards or
+  // backwards, until the score drops "xDrop" below the best score. Returns
+  // the number of residues in the best extension and adds its columns to
+  // "stats"
+  static size_t extendEnd( const std::string &qSeq, size_t qPos,
+    const std::string_view sSeq, size_t sPos, const bool isForward,
+    AlignStats &stats );
+
+  // Align two sequences end to end within a band around the diagonal that
+  // joins their ends
+  static AlignStats alignGap( const char* qSeq, const size_t qLen,
+    const char* sSeq, const size_t sLen );
+
+  // Return the two bit code of a residue, or -1 if it is not a base
+  static int baseCode( const char c );
+
+  // Invertible hash of a k-mer, so that different k-mers do not collide
+  static uint64_t hashKmer( uint64_t kmer );
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,202 @@
+#include "PackedSeq.h"
+
+// -----------------------------------------------------------------------------
+// PackedSeq
+// Ryan D. Crawford
+// 2020/06/02
+// -----------------------------------------------------------------------------
+
+// ---- Lookup tables ----------------------------------------------------------
+
+// Two bit code for each residue. Residues that can not be represented in two
+// bits are assigned the value 4
+static const std::vector< uint8_t > encodeTable = []()
+{
+  std::vector< uint8_t > table( 256, 4 );
+  table[ 'A' ] = 0;
+  table[ 'C' ] = 1;
+  table[ 'G' ] = 2;
+  table[ 'T' ] = 3;
+  return table;
+}();
+
+// The four residues encoded by each possible byte of the packed sequence
+static const std::vector< uint32_t > decodeTable = []()
+{
+  const char bases[] = "ACGT";
+  std::vector< uint32_t > table( 256 );
+  for ( unsigned int i = 0; i < 256; i++ )
+  {
+    char quad[4];
+    for ( int j = 0; j < 4; j++ ) quad[j] = bases[ ( i >> ( 2 * j ) ) & 3 ];
+    memcpy( &table[i], quad, 4 );
+  }
+  return table;
+}();
+
+// ---- PackedSeq member functions ---------------------------------------------
+
+void PackedSeq::append( const char* seq, const size_t len )
+{
+  words.resize( ( nBases + len + 31 ) / 32, 0 );
+
+  for ( size_t i = 0; i < len; i++, nBases++ )
+  {
+    uint8_t code = encodeTable[ static_cast< unsigned char >( seq[i] ) ];
+
+    // Residues other than A, C, G and T are added to the run length table.
+    // If this residue extends the previous run, increment its length.
+    if ( code == 4 )
+    {
+      if ( !ambigRuns.empty() && ambigRuns.back().base == seq[i] &&
+        ambigRuns.back().start + ambigRuns.back().len == nBases )
+      {
+        ambigRuns.back().len ++;
+      } else {
+        ambigRuns.push_back( { nBases, 1, seq[i] } );
+      }
+      code = 0;
+    }
+    words[ nBases / 32 ] |= uint64_t( code ) << ( 2 * ( nBases % 32 ) );
+  }
+}
+
+void PackedSeq::decode(
+  const size_t pos, const size_t len, char* out
+  ) const
+{
+  const uint8_t* bytes = reinterpret_cast< const uint8_t* >( words.data() );
+  size_t i = 0;
+
+  // Decode single residues until the position is aligned to a packed byte
+  for ( ; i < len && ( pos + i ) % 4 != 0; i++ )
+  {
+    size_t p = pos + i;
+    out[i] = "ACGT"[ ( words[ p / 32 ] >> ( 2 * ( p % 32 ) ) ) & 3 ];
+  }
+
+  // Decode four residues at a time from each byte
+  for ( ; i + 4 <= len; i += 4 )
+    memcpy( out + i, &decodeTable[ bytes[ ( pos + i ) / 4 ] ], 4 );
+
+  // Decode the remaining residues
+  for ( ; i < len; i++ )
+  {
+    size_t p = pos + i;
+    out[i] = "ACGT"[ ( words[ p / 32 ] >> ( 2 * ( p % 32 ) ) ) & 3 ];
+  }
+
+  // Find the first run of ambiguous residues that could overlap the range
+  // and overlay the runs on the decoded residues
+  auto it = std::upper_bound( ambigRuns.begin(), ambigRuns.end(), pos,
+    []( const size_t p, const AmbigRun &run ) { return p < run.start; } );
+  if ( it != ambigRuns.begin() ) it--;
+
+  for ( ; it != ambigRuns.end() && it->start < pos + len; it++ )
+  {
+    size_t start = std::max( it->start, pos );
+    size_t end   = std::min( it->start + it->len, pos + len );
+    if ( start < end ) memset( out + start - pos, it->base, end - start );
+  }
+}
+
+std::string PackedSeq::substr( const size_t pos, const size_t len ) const
+{
+  std::string seq( len, '\0' );
+  decode( pos, len, &seq[0] );
+  return seq;
+}
+
+size_t PackedSeq::size() const
+{
+  return nBases;
+}
+
+void PackedSeq::reserve( const size_t len )
+{
+  words.reserve( ( len + 31 ) / 32 );
+}
+
+void PackedSeq::clear()
+{
+  nBases = 0;
+  std::vector< uint64_t >().swap( words );
+  std::vector< AmbigRun >().swap( ambigRuns );
+}
+
+size_t PackedSeq::memUsage() const
+{
+  return words.capacity() * sizeof( uint64_t ) +
+    ambigRuns.capacity() * sizeof( AmbigRun );
+}
+
+const std::vector< PackedSeq::AmbigRun >& PackedSeq::getAmbigRuns() const
+{
+  return ambigRuns;
+}
+
+uint64_t PackedSeq::hash() const
+{
+  // Hash the packed words, then each field of the ambiguous runs
+  uint64_t h = hashBytes( words.data(), words.size() * sizeof( uint64_t ),
+    nBases );
+  for ( const auto &run : ambigRuns )
+  {
+    uint64_t fields[3] = { run.start, run.len, uint64_t( run.base ) };
+    h = hashBytes( fields, sizeof( fields ), h );
+  }
+  return h;
+}
+
+void PackedSeq::serialize( std::string &buf ) const
+{
+  putValue( buf, uint64_t( nBases ) );
+  putValue( buf, uint64_t( words.size() ) );
+  buf.append( reinterpret_cast< const char* >( words.data() ),
+    words.size() * sizeof( uint64_t ) );
+  putValue( buf, uint64_t( ambigRuns.size() ) );
+  for ( const auto &run : ambigRuns )
+  {
+    putValue( buf, uint64_t( run.start ) );
+    putValue( buf, run.len );
+    putValue( buf, run.base );
+  }
+}
+
+bool PackedSeq::deserialize( const char* &pos, const char* end )
+{
+  uint64_t nWords;
+  uint64_t nRuns;
+  uint64_t len;
+
+  clear();
+  if ( !getValue( pos, end, len ) || !getValue( pos, end, nWords ) )
+    return false;
+  if ( nWords != ( len + 31 ) / 32 ||
+    uint64_t( end - pos ) < nWords * sizeof( uint64_t ) )
+  {
+    return false;
+  }
+
+  // Copy the packed words in one block
+  nBases = len;
+  words.resize( nWords );
+  memcpy( words.data(), pos, nWords * sizeof( uint64_t ) );
+  pos += nWords * sizeof( uint64_t );
+
+  if ( !getValue( pos, end, nRuns ) ) return false;
+  ambigRuns.resize( nRuns );
+  for ( auto &run : ambigRuns )
+  {
+    uint64_t start;
+    if ( !getValue( pos, end, start ) || !getValue( pos, end, run.len ) ||
+      !getValue( pos, end, run.base ) )
+    {
+      return false;
+    }
+    run.start = start;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
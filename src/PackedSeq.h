@@ -0,0 +1,97 @@
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "BinaryIO.h"
+#include "Hash.h"
+
+// -----------------------------------------------------------------------------
+// PackedSeq
+// Ryan D. Crawford
+// 2020/06/02
+// -----------------------------------------------------------------------------
+// This class stores a nucleotide sequence using two bits per base. Residues
+// that are not A, C, G or T (N's and the other IUPAC ambiguity codes) are
+// stored as A in the packed words and recorded in a run length table of
+// ambiguous bases, which is overlaid on the packed bases when a range is
+// decoded. Residues are expected to be upper case.
+// -----------------------------------------------------------------------------
+
+#ifndef _PACKED_SEQ_
+#define _PACKED_SEQ_
+class PackedSeq
+{
+public:
+
+  // Default ctor
+  PackedSeq(): nBases( 0 )
+  { ; }
+
+  // Copy and move ctors and assignment
+  PackedSeq( const PackedSeq &rhs ) = default;
+  PackedSeq( PackedSeq &&rhs ) = default;
+  PackedSeq& operator=( const PackedSeq &rhs ) = default;
+  PackedSeq& operator=( PackedSeq &&rhs ) = default;
+
+  // Dtor: does nothing
+  ~PackedSeq()
+  { ; }
+
+  // A run of identical non-ACGT residues
+  struct AmbigRun
+  {
+    size_t   start; // Position of the first residue in the run
+    uint32_t len;   // Number of residues in the run
+    char     base;  // Residue repeated in this run
+  };
+
+  // Append residues to the end of the sequence
+  void append( const char* seq, const size_t len );
+
+  // Decode "len" residues starting at "pos" into the character array "out".
+  // The range must fall within the sequence
+  void decode( const size_t pos, const size_t len, char* out ) const;
+
+  // Return the residues in the input range as a string
+  std::string substr( const size_t pos, const size_t len ) const;
+
+  // Return the number of residues in the sequence
+  size_t size() const;
+
+  // Preallocate space for the input number of residues
+  void reserve( const size_t len );
+
+  // Free the memory associated with the sequence
+  void clear();
+
+  // Return the approximate number of bytes used by this sequence
+  size_t memUsage() const;
+
+  // Return the table of ambiguous residues
+  const std::vector< AmbigRun >& getAmbigRuns() const;
+
+  // Return a hash of the residues in the sequence
+  uint64_t hash() const;
+
+  // Append the packed sequence to a binary buffer
+  void serialize( std::string &buf ) const;
+
+  // Read a packed sequence written by "serialize" and advance the position
+  // in the buffer. Returns false if the buffer is truncated.
+  bool deserialize( const char* &pos, const char* end );
+
+private:
+
+  // Number of residues in the sequence
+  size_t nBases;
+
+  // Packed residues, 32 bases per word with the first base in the low bits
+  std::vector< uint64_t > words;
+
+  // Runs of residues that are not A, C, G or T, sorted by start position
+  std::vector< AmbigRun > ambigRuns;
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,112 @@
+#include "PafAligner.h"
+
+// -----------------------------------------------------------------------------
+// PafAligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+
+// ---- PafAligner member functions --------------------------------------------
+
+PafAligner::PafAligner( const std::string &cmd )
+{
+  std::stringstream ss( cmd );
+  std::string       arg;
+  while ( ss >> arg ) this->cmd.push_back( arg );
+}
+
+std::string PafAligner::getVersion()
+{
+  // The options of the command are part of the version, since they may
+  // change the index
+  if ( cmd.empty() ) return "";
+  std::string version = getProgramOutput( { cmd[0], "--version" } );
+  if ( version.empty() ) return version;
+  return getParams() + version;
+}
+
+std::string PafAligner::getParams() const
+{
+  std::string params;
+  for ( const auto &arg : cmd ) params += arg + " ";
+  return params;
+}
+
+bool PafAligner::canCombine() const
+{
+  return false;
+}
+
+bool PafAligner::indexRanges(
+  const Genome* genome, const std::vector< SeqRange > &ranges,
+  const std::string &idxPath
+  )
+{
+  if ( cmd.empty() ) return false;
+  std::vector< std::string > args = cmd;
+  args.insert( args.end(), { "-d", idxPath + ".mmi", "-" } );
+  return runProgram( args, genome, ranges,
+    []( std::string & /* line */ ) { ; } );
+}
+
+bool PafAligner::combineIndexes(
+  const std::vector< std::string > & /* idxPaths */,
+  const std::string                & /* outPath */
+  )
+{
+  return false;
+}
+
+bool PafAligner::search(
+  const Genome*                               query,
+  const std::vector< SeqRange >*              ranges,
+  const std::string                           &idxPath,
+  const uint32_t                              /* nSubjSeqs */,
+  const std::function< void( AlignRecord& ) > &onHit
+  )
+{
+  if ( cmd.empty() ) return false;
+  std::vector< std::string > args = cmd;
+  args.insert( args.end(), { idxPath + ".mmi", "-" } );
+
+  std::vector< SeqRange > genomeRanges;
+  if ( ranges == nullptr ) genomeRanges = getGenomeRanges( query );
+  AlignRecord rec;
+  return runProgram( args, query, ranges != nullptr ? *ranges : genomeRanges,
+    [&]( std::string &line ) { if ( parseLine( line, rec ) ) onHit( rec ); } );
+}
+
+bool PafAligner::parseLine( const std::string &line, AlignRecord &rec ) const
+{
+  std::string qLen;
+  std::string sLen;
+  std::string strand;
+  uint32_t    qStart;
+  uint32_t    sStart;
+  uint32_t    sEnd;
+  uint32_t    nMatch;
+  uint32_t    blockLen;
+
+  if ( line.empty() ) return false;
+  std::stringstream ss( line );
+  ss >> rec.qName >> qLen >> qStart >> rec.qEnd >> strand >> rec.sName >> sLen
+     >> sStart >> sEnd >> nMatch >> blockLen;
+  if ( ss.fail() || blockLen == 0 ) return false;
+
+  // PAF positions are zero based and the ends are exclusive. Hits on the
+  // reverse strand are reported with the subject positions reversed
+  rec.qStart = qStart + 1;
+  if ( strand == "-" )
+  {
+    rec.sStart = sEnd;
+    rec.sEnd   = sStart + 1;
+  } else {
+    rec.sStart = sStart + 1;
+    rec.sEnd   = sEnd;
+  }
+  rec.length = blockLen;
+  rec.pIdent = 100.0 * nMatch / blockLen;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,60 @@
+#include "Aligner.h"
+#include <sstream>
+
+// -----------------------------------------------------------------------------
+// PafAligner
+// Ryan D. Crawford
+// 2020/07/24
+// -----------------------------------------------------------------------------
+// This class aligns genomes with an external aligner that writes its hits
+// in the PAF format, such as minimap2. The command used to run the aligner
+// is given with its options, eg "minimap2 -c -x asm5". The index of a
+// genome is written by running the command with "-d <index>.mmi" on the
+// fasta file, and a query is searched by running the command on the index
+// and the query fasta file. The sequences are always written to the aligner
+// on its standard input. Indexes can not be combined.
+// -----------------------------------------------------------------------------
+
+#ifndef _PAF_ALIGNER_
+#define _PAF_ALIGNER_
+class PafAligner: public Aligner
+{
+public:
+
+  // Ctor: takes the command used to run the aligner. The arguments are
+  // separated by white space
+  PafAligner( const std::string &cmd );
+
+  // Dtor
+  ~PafAligner()
+  { ; }
+
+  std::string getVersion();
+
+  std::string getParams() const;
+
+  bool canCombine() const;
+
+  bool indexRanges( const Genome* genome,
+    const std::vector< SeqRange > &ranges, const std::string &idxPath );
+
+  bool combineIndexes( const std::vector< std::string > &idxPaths,
+    const std::string &outPath );
+
+  bool search( const Genome* query, const std::vector< SeqRange >* ranges,
+    const std::string &idxPath, const uint32_t nSubjSeqs,
+    const std::function< void( AlignRecord& ) > &onHit );
+
+private:
+
+  // The program and its options
+  std::vector< std::string > cmd;
+
+  // Parse a line of PAF output. The identity is the number of matching
+  // residues over the length of the alignment block. Returns false if the
+  // line is empty or malformed
+  bool parseLine( const std::string &line, AlignRecord &rec ) const;
+};
+#endif
+
+// -----------------------------------------------------------------------------
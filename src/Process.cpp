@@ -0,0 +1,135 @@
+#include "Process.h"
+
+// -----------------------------------------------------------------------------
+// Process
+// Ryan D. Crawford
+// 2020/07/14
+// -----------------------------------------------------------------------------
+
+extern char **environ;
+
+// ---- Process member functions -----------------------------------------------
+
+Process::~Process()
+{
+  closeStdin();
+  if ( outFd != -1 ) close( outFd );
+  outFd = -1;
+  wait();
+}
+
+bool Process::start(
+  const std::vector< std::string > &args, const bool isStdinPiped
+  )
+{
+  int outPipe[2]; // Pipe from the standard output of the program
+  int inPipe[2];  // Pipe to the standard input of the program
+
+  if ( args.empty() || pid != -1 ) return false;
+
+  if ( pipe2( outPipe, O_CLOEXEC ) == -1 ) return false;
+  if ( isStdinPiped && pipe2( inPipe, O_CLOEXEC ) == -1 )
+  {
+    close( outPipe[0] );
+    close( outPipe[1] );
+    return false;
+  }
+
+  // The ends of the pipes used by the program are duplicated onto its
+  // standard streams, which are not closed on exec
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init( &actions );
+  posix_spawn_file_actions_adddup2( &actions, outPipe[1], STDOUT_FILENO );
+  if ( isStdinPiped )
+    posix_spawn_file_actions_adddup2( &actions, inPipe[0], STDIN_FILENO );
+
+  std::vector< char* > argv;
+  for ( const auto &arg : args )
+    argv.push_back( const_cast< char* >( arg.c_str() ) );
+  argv.push_back( nullptr );
+
+  int status = posix_spawnp( &pid, argv[0], &actions, nullptr, argv.data(),
+    environ );
+  posix_spawn_file_actions_destroy( &actions );
+
+  // Close the ends of the pipes used by the program
+  close( outPipe[1] );
+  if ( isStdinPiped ) close( inPipe[0] );
+  if ( status != 0 )
+  {
+    pid = -1;
+    close( outPipe[0] );
+    if ( isStdinPiped ) close( inPipe[1] );
+    return false;
+  }
+
+  outFd  = outPipe[0];
+  inFd   = isStdinPiped ? inPipe[1] : -1;
+  buf.clear();
+  bufPos = 0;
+  return true;
+}
+
+int Process::getStdin() const
+{
+  return inFd;
+}
+
+void Process::closeStdin()
+{
+  if ( inFd != -1 ) close( inFd );
+  inFd = -1;
+}
+
+bool Process::readLine( std::string &line )
+{
+  const size_t blockSize = 1 << 16; // Number of bytes to read at a time
+
+  while ( true )
+  {
+    // Return the next complete line in the buffer
+    size_t eol = buf.find( '\n', bufPos );
+    if ( eol != std::string::npos )
+    {
+      line.assign( buf, bufPos, eol - bufPos );
+      bufPos = eol + 1;
+      return true;
+    }
+
+    // Move the partial line to the start of the buffer and read more output
+    buf.erase( 0, bufPos );
+    bufPos = 0;
+    ssize_t n = -1;
+    if ( outFd != -1 )
+    {
+      size_t len = buf.size();
+      buf.resize( len + blockSize );
+      do n = read( outFd, &buf[ len ], blockSize );
+      while ( n == -1 && errno == EINTR );
+      buf.resize( len + std::max( n, ssize_t( 0 ) ) );
+    }
+
+    // At the end of the output, return the last line if it has no new line
+    if ( n <= 0 )
+    {
+      if ( buf.empty() ) return false;
+      line.swap( buf );
+      buf.clear();
+      return true;
+    }
+  }
+}
+
+int Process::wait()
+{
+  if ( pid == -1 ) return -1;
+  int status;
+  pid_t ret;
+  do ret = waitpid( pid, &status, 0 );
+  while ( ret == -1 && errno == EINTR );
+  pid = -1;
+  if ( ret == -1 || !WIFEXITED( status ) ) return -1;
+  return WEXITSTATUS( status );
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cerrno>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// -----------------------------------------------------------------------------
+// Process
+// Ryan D. Crawford
+// 2020/07/14
+// -----------------------------------------------------------------------------
+// This class runs an external program, such as the aligner, without a shell.
+// The program is started with posix_spawn and its standard output is read
+// through a pipe one line at a time as it is written. Optionally the
+// standard input of the program is also a pipe, so that data can be fed to
+// it from memory. The pipes are closed on exec so that processes started
+// concurrently from different threads do not inherit each others pipes.
+// A program that exits before reading all of its input raises SIGPIPE in
+// the writer, so the program using this class must ignore SIGPIPE, as
+// pearl does in "main". Writes to the input then fail with EPIPE instead.
+// -----------------------------------------------------------------------------
+
+#ifndef _PROCESS_
+#define _PROCESS_
+class Process
+{
+public:
+
+  // Default ctor
+  Process()
+  { ; }
+
+  // Dtor: closes the pipes and waits for the program if it is running
+  ~Process();
+
+  // Processes can not be copied
+  Process( const Process &rhs ) = delete;
+  Process& operator=( const Process &rhs ) = delete;
+
+  // Start the program. The first argument is the program, which is found in
+  // the PATH. If "isStdinPiped" is true the standard input of the program
+  // can be written to with "getStdin". Returns false if the program could
+  // not be started
+  bool start( const std::vector< std::string > &args,
+    const bool isStdinPiped = false );
+
+  // Return the file descriptor used to write to the standard input of the
+  // program, or -1 if the input is not piped
+  int getStdin() const;
+
+  // Close the standard input of the program, signaling the end of the input
+  void closeStdin();
+
+  // Read the next line of the standard output of the program, without the
+  // new line. Returns false at the end of the output
+  bool readLine( std::string &line );
+
+  // Wait for the program to finish. Returns the exit status of the program,
+  // or -1 if it did not exit normally
+  int wait();
+
+private:
+
+  // Process id of the program, -1 if it is not running
+  pid_t pid = -1;
+
+  // Write end of the pipe to the standard input of the program
+  int inFd = -1;
+
+  // Read end of the pipe from the standard output of the program
+  int outFd = -1;
+
+  // Output of the program that has been read but not returned
+  std::string buf;
+
+  // Position of the next line in the buffer
+  size_t bufPos = 0;
+};
+#endif
+
+// -----------------------------------------------------------------------------
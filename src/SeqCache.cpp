@@ -0,0 +1,79 @@
+#include "SeqCache.h"
+
+// -----------------------------------------------------------------------------
+// SeqCache
+// Ryan D. Crawford
+// 2020/07/07
+// -----------------------------------------------------------------------------
+
+// ---- SeqCache member functions ----------------------------------------------
+
+void SeqCache::decodeSeq(
+  const BioSeq* seqs, const unsigned int seqIdx, const size_t startPos,
+  const size_t len, char* out
+  )
+{
+  // Resident sequences are already in memory
+  if ( seqs->isResident() )
+  {
+    seqs->decodeSeq( seqIdx, startPos, len, out );
+    return;
+  }
+
+  // Copy the overlap with each window spanned by the range
+  size_t pos = startPos;
+  size_t end = startPos + len;
+  while ( pos < end )
+  {
+    size_t window = pos / windowSize;
+    const std::string &residues = getWindow( { seqs, seqIdx, window } );
+    size_t offset = pos - window * windowSize;
+    size_t n      = std::min( end - pos, residues.size() - offset );
+    memcpy( out + pos - startPos, residues.data() + offset, n );
+    pos += n;
+  }
+}
+
+const std::string& SeqCache::getWindow( const WindowKey &key )
+{
+  // Move cached windows to the front of the list
+  auto it = windowMap.find( key );
+  if ( it != windowMap.end() )
+  {
+    nHits++;
+    windows.splice( windows.begin(), windows, it->second );
+    return it->second->second;
+  }
+
+  // Decode the window from the genome
+  nMisses++;
+  size_t start = key.window * windowSize;
+  size_t len   = std::min( windowSize, key.seqs->getSeqLen( key.seqIdx ) -
+    start );
+  std::string residues( len, '\0' );
+  key.seqs->decodeSeq( key.seqIdx, start, len, &residues[0] );
+  windows.emplace_front( key, std::move( residues ) );
+  windowMap[ key ] = windows.begin();
+  nBytes += len;
+
+  // Evict the least recently used windows. The new window is always kept
+  while ( nBytes > maxBytes && windows.size() > 1 )
+  {
+    nBytes -= windows.back().second.size();
+    windowMap.erase( windows.back().first );
+    windows.pop_back();
+  }
+  return windows.front().second;
+}
+
+size_t SeqCache::getHits() const
+{
+  return nHits;
+}
+
+size_t SeqCache::getMisses() const
+{
+  return nMisses;
+}
+
+// -----------------------------------------------------------------------------
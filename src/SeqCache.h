@@ -0,0 +1,97 @@
+#include "BioSeq.h"
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// -----------------------------------------------------------------------------
+// SeqCache
+// Ryan D. Crawford
+// 2020/07/07
+// -----------------------------------------------------------------------------
+// This class is a least recently used cache of decoded windows of contigs.
+// It is used to read sequences from genomes whose sequences are not
+// resident in memory (see "BioSeq::releaseSeqs"), so that overlapping
+// requests for the same region are read from the fasta file once. Windows
+// are evicted once the decoded residues exceed the memory budget. Sequences
+// that are resident are decoded directly without being cached. This class is
+// not thread safe.
+// -----------------------------------------------------------------------------
+
+#ifndef _SEQ_CACHE_
+#define _SEQ_CACHE_
+class SeqCache
+{
+public:
+
+  // Ctor: takes the maximium number of bytes of decoded windows to keep and
+  // the number of residues in each window
+  SeqCache( const size_t maxBytes, const size_t windowSize = 1 << 20 ):
+    maxBytes( maxBytes ), windowSize( windowSize )
+  { ; }
+
+  // Dtor
+  ~SeqCache()
+  { ; }
+
+  // Decode "len" residues of the contig at the input index starting at
+  // "startPos" into the character array "out". The range must be valid
+  void decodeSeq( const BioSeq* seqs, const unsigned int seqIdx,
+    const size_t startPos, const size_t len, char* out );
+
+  // Return the number of window requests that were found in the cache
+  size_t getHits() const;
+
+  // Return the number of windows that were read from the genomes
+  size_t getMisses() const;
+
+private:
+
+  // Identifies a window of a contig
+  struct WindowKey
+  {
+    const BioSeq* seqs;   // Genome containing the contig
+    unsigned int  seqIdx; // Index of the contig
+    size_t        window; // Index of the window in the contig
+
+    bool operator==( const WindowKey &rhs ) const
+    {
+      return seqs == rhs.seqs && seqIdx == rhs.seqIdx && window == rhs.window;
+    }
+  };
+
+  struct WindowHash
+  {
+    size_t operator()( const WindowKey &key ) const
+    {
+      return std::hash< const BioSeq* >()( key.seqs ) ^
+        ( size_t( key.seqIdx ) << 32 ) ^ key.window;
+    }
+  };
+
+  typedef std::list< std::pair< WindowKey, std::string > > WindowList;
+
+  // Maximium number of bytes of decoded residues
+  size_t maxBytes;
+
+  // Number of residues in each window
+  size_t windowSize;
+
+  // Number of bytes of decoded residues in the cache
+  size_t nBytes = 0;
+
+  // Windows in the order they were used, most recent first
+  WindowList windows;
+
+  // Position of each window in the list
+  std::unordered_map< WindowKey, WindowList::iterator, WindowHash > windowMap;
+
+  // Counts of the requests found in, and missing from, the cache
+  size_t nHits   = 0;
+  size_t nMisses = 0;
+
+  // Return the decoded residues of a window, reading it if it is not cached
+  const std::string& getWindow( const WindowKey &key );
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,245 @@
+#include "SeqKernel.h"
+#include <immintrin.h>
+
+// -----------------------------------------------------------------------------
+// SeqKernel
+// Ryan D. Crawford
+// 2020/06/16
+// -----------------------------------------------------------------------------
+
+// ---- Lookup tables ----------------------------------------------------------
+
+// Class of each byte: 0 for white space that is removed, 1 for residues in
+// the IUPAC alphabet and 2 for anything else. Lower case residues have the
+// same class as upper case.
+static const char iupac[] = "ACGTUNRYKMSWBDHV";
+
+static const struct ByteTable
+{
+  uint8_t byteClass[ 256 ];
+  ByteTable()
+  {
+    for ( int c = 0; c < 256; c++ ) byteClass[c] = c <= ' ' ? 0 : 2;
+    for ( const char* r = iupac; *r; r++ )
+    {
+      byteClass[ uint8_t( *r ) ]        = 1;
+      byteClass[ uint8_t( *r + 0x20 ) ] = 1;
+    }
+  }
+} byteTable;
+
+// Valid letters indexed by their offset from 'A', split into two tables of
+// sixteen for the byte shuffle instructions. Valid letters are 0xff.
+static const struct LetterTable
+{
+  uint8_t lo[ 16 ];
+  uint8_t hi[ 16 ];
+  LetterTable()
+  {
+    memset( lo, 0, 16 );
+    memset( hi, 0, 16 );
+    for ( const char* r = iupac; *r; r++ )
+    {
+      int idx = *r - 'A';
+      if ( idx < 16 ) lo[ idx ] = 0xff;
+      else hi[ idx - 16 ] = 0xff;
+    }
+  }
+} letterTable;
+
+// ---- Scalar kernel ----------------------------------------------------------
+
+static size_t normalizeScalar(
+  const char* in, const size_t len, char* out, SeqStats &stats
+  )
+{
+  size_t nOut = 0;
+  for ( size_t i = 0; i < len; i++ )
+  {
+    uint8_t c    = in[i];
+    uint8_t type = byteTable.byteClass[c];
+    if ( type == 0 ) continue;
+    if ( c >= 'a' && c <= 'z' ) c -= 0x20;
+    stats.nN       += c == 'N';
+    stats.nInvalid += type == 2;
+    out[ nOut++ ] = c;
+  }
+  return nOut;
+}
+
+// Copy the bytes in a block that are not white space. Bit i of "wsMask" is
+// set if byte i of the block is white space.
+static inline size_t compactBlock(
+  const char* block, const size_t blockLen, uint32_t wsMask, char* out
+  )
+{
+  size_t nOut = 0;
+  size_t pos  = 0;
+  while ( wsMask != 0 )
+  {
+    size_t wsPos = __builtin_ctz( wsMask );
+    memmove( out + nOut, block + pos, wsPos - pos );
+    nOut   += wsPos - pos;
+    pos     = wsPos + 1;
+    wsMask &= wsMask - 1;
+  }
+  memmove( out + nOut, block + pos, blockLen - pos );
+  return nOut + blockLen - pos;
+}
+
+// ---- AVX2 kernel ------------------------------------------------------------
+
+__attribute__(( target( "avx2" ) ))
+static size_t normalizeAvx2(
+  const char* in, const size_t len, char* out, SeqStats &stats
+  )
+{
+  const __m256i space   = _mm256_set1_epi8( ' ' );
+  const __m256i lowerA  = _mm256_set1_epi8( 'a' );
+  const __m256i letters = _mm256_set1_epi8( 25 );
+  const __m256i caseBit = _mm256_set1_epi8( 0x20 );
+  const __m256i upperA  = _mm256_set1_epi8( 'A' );
+  const __m256i sixteen = _mm256_set1_epi8( 16 );
+  const __m256i minus1  = _mm256_set1_epi8( -1 );
+  const __m256i nChar   = _mm256_set1_epi8( 'N' );
+  const __m256i tableLo = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128( reinterpret_cast< const __m128i* >( letterTable.lo ) ) );
+  const __m256i tableHi = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128( reinterpret_cast< const __m128i* >( letterTable.hi ) ) );
+
+  size_t i    = 0;
+  size_t nOut = 0;
+  alignas( 32 ) char block[ 32 ];
+  for ( ; i + 32 <= len; i += 32 )
+  {
+    __m256i c =
+      _mm256_loadu_si256( reinterpret_cast< const __m256i* >( in + i ) );
+
+    // White space is any byte less than or equal to a space
+    __m256i ws = _mm256_cmpeq_epi8( _mm256_max_epu8( c, space ), space );
+
+    // Clear the case bit of the lower case letters
+    __m256i fromA = _mm256_sub_epi8( c, lowerA );
+    __m256i lower =
+      _mm256_cmpeq_epi8( _mm256_min_epu8( fromA, letters ), fromA );
+    c = _mm256_xor_si256( c, _mm256_and_si256( lower, caseBit ) );
+
+    // Look up the upper case letters in the alphabet
+    __m256i idx   = _mm256_sub_epi8( c, upperA );
+    __m256i idxHi = _mm256_sub_epi8( idx, sixteen );
+    __m256i inLo  = _mm256_and_si256( _mm256_cmpgt_epi8( idx, minus1 ),
+      _mm256_cmpgt_epi8( sixteen, idx ) );
+    __m256i inHi  = _mm256_and_si256( _mm256_cmpgt_epi8( idxHi, minus1 ),
+      _mm256_cmpgt_epi8( sixteen, idxHi ) );
+    __m256i valid = _mm256_or_si256(
+      _mm256_and_si256( _mm256_shuffle_epi8( tableLo, idx ), inLo ),
+      _mm256_and_si256( _mm256_shuffle_epi8( tableHi, idxHi ), inHi ) );
+    valid = _mm256_or_si256( valid, ws );
+
+    uint32_t wsMask  = _mm256_movemask_epi8( ws );
+    uint32_t badMask = ~uint32_t( _mm256_movemask_epi8( valid ) );
+    uint32_t nMask   = _mm256_movemask_epi8( _mm256_cmpeq_epi8( c, nChar ) );
+    stats.nN       += __builtin_popcount( nMask );
+    stats.nInvalid += __builtin_popcount( badMask );
+
+    // Write the block, removing any white space
+    if ( wsMask == 0 )
+    {
+      _mm256_storeu_si256( reinterpret_cast< __m256i* >( out + nOut ), c );
+      nOut += 32;
+    } else {
+      _mm256_store_si256( reinterpret_cast< __m256i* >( block ), c );
+      nOut += compactBlock( block, 32, wsMask, out + nOut );
+    }
+  }
+  return nOut + normalizeScalar( in + i, len - i, out + nOut, stats );
+}
+
+// ---- SSE4.2 kernel ----------------------------------------------------------
+
+__attribute__(( target( "sse4.2" ) ))
+static size_t normalizeSse42(
+  const char* in, const size_t len, char* out, SeqStats &stats
+  )
+{
+  const __m128i space   = _mm_set1_epi8( ' ' );
+  const __m128i lowerA  = _mm_set1_epi8( 'a' );
+  const __m128i letters = _mm_set1_epi8( 25 );
+  const __m128i caseBit = _mm_set1_epi8( 0x20 );
+  const __m128i upperA  = _mm_set1_epi8( 'A' );
+  const __m128i sixteen = _mm_set1_epi8( 16 );
+  const __m128i minus1  = _mm_set1_epi8( -1 );
+  const __m128i nChar   = _mm_set1_epi8( 'N' );
+  const __m128i tableLo =
+    _mm_loadu_si128( reinterpret_cast< const __m128i* >( letterTable.lo ) );
+  const __m128i tableHi =
+    _mm_loadu_si128( reinterpret_cast< const __m128i* >( letterTable.hi ) );
+
+  size_t i    = 0;
+  size_t nOut = 0;
+  alignas( 16 ) char block[ 16 ];
+  for ( ; i + 16 <= len; i += 16 )
+  {
+    __m128i c = _mm_loadu_si128( reinterpret_cast< const __m128i* >( in + i ) );
+
+    // White space is any byte less than or equal to a space
+    __m128i ws = _mm_cmpeq_epi8( _mm_max_epu8( c, space ), space );
+
+    // Clear the case bit of the lower case letters
+    __m128i fromA = _mm_sub_epi8( c, lowerA );
+    __m128i lower = _mm_cmpeq_epi8( _mm_min_epu8( fromA, letters ), fromA );
+    c = _mm_xor_si128( c, _mm_and_si128( lower, caseBit ) );
+
+    // Look up the upper case letters in the alphabet
+    __m128i idx   = _mm_sub_epi8( c, upperA );
+    __m128i idxHi = _mm_sub_epi8( idx, sixteen );
+    __m128i inLo  = _mm_and_si128( _mm_cmpgt_epi8( idx, minus1 ),
+      _mm_cmpgt_epi8( sixteen, idx ) );
+    __m128i inHi  = _mm_and_si128( _mm_cmpgt_epi8( idxHi, minus1 ),
+      _mm_cmpgt_epi8( sixteen, idxHi ) );
+    __m128i valid = _mm_or_si128(
+      _mm_and_si128( _mm_shuffle_epi8( tableLo, idx ), inLo ),
+      _mm_and_si128( _mm_shuffle_epi8( tableHi, idxHi ), inHi ) );
+    valid = _mm_or_si128( valid, ws );
+
+    uint32_t wsMask  = _mm_movemask_epi8( ws );
+    uint32_t badMask = ~uint32_t( _mm_movemask_epi8( valid ) ) & 0xffff;
+    uint32_t nMask   = _mm_movemask_epi8( _mm_cmpeq_epi8( c, nChar ) );
+    stats.nN       += __builtin_popcount( nMask );
+    stats.nInvalid += __builtin_popcount( badMask );
+
+    // Write the block, removing any white space
+    if ( wsMask == 0 )
+    {
+      _mm_storeu_si128( reinterpret_cast< __m128i* >( out + nOut ), c );
+      nOut += 16;
+    } else {
+      _mm_store_si128( reinterpret_cast< __m128i* >( block ), c );
+      nOut += compactBlock( block, 16, wsMask, out + nOut );
+    }
+  }
+  return nOut + normalizeScalar( in + i, len - i, out + nOut, stats );
+}
+
+// ---- Dispatch ---------------------------------------------------------------
+
+// Select the kernel once, based on the instruction sets of the processor
+typedef size_t ( *NormalizeFn )( const char*, const size_t, char*, SeqStats& );
+
+static NormalizeFn selectKernel()
+{
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) return normalizeAvx2;
+  if ( __builtin_cpu_supports( "sse4.2" ) ) return normalizeSse42;
+  return normalizeScalar;
+}
+
+size_t normalizeSeq(
+  const char* in, const size_t len, char* out, SeqStats &stats
+  )
+{
+  static const NormalizeFn kernel = selectKernel();
+  return kernel( in, len, out, stats );
+}
+
+// -----------------------------------------------------------------------------
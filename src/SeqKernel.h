@@ -0,0 +1,37 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// -----------------------------------------------------------------------------
+// SeqKernel
+// Ryan D. Crawford
+// 2020/06/16
+// -----------------------------------------------------------------------------
+// This file defines the kernel used to normalize raw sequence read from
+// fasta files. In a single pass over the input the residues are converted to
+// upper case, line endings and other white space are removed, residues are
+// validated against the IUPAC nucleotide alphabet and the N's are counted.
+// AVX2 and SSE4.2 implementations are selected at run time based on the
+// processor, with a scalar implementation used otherwise.
+// -----------------------------------------------------------------------------
+
+#ifndef _SEQ_KERNEL_
+#define _SEQ_KERNEL_
+
+// Counts accumulated while normalizing sequence
+struct SeqStats
+{
+  size_t nN       = 0; // Number of N residues
+  size_t nInvalid = 0; // Number of residues not in the IUPAC alphabet
+};
+
+// Normalize "len" bytes of raw sequence from "in" and write the residues to
+// "out", which must have room for "len" bytes. "in" and "out" may be the
+// same buffer. The counts in "stats" are incremented. Returns the number of
+// residues written.
+size_t normalizeSeq( const char* in, const size_t len, char* out,
+  SeqStats &stats );
+
+#endif
+
+// -----------------------------------------------------------------------------
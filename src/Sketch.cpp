@@ -0,0 +1,115 @@
+#include "Sketch.h"
+
+// -----------------------------------------------------------------------------
+// Sketch
+// Ryan D. Crawford
+// 2020/07/26
+// -----------------------------------------------------------------------------
+
+// ---- Sketch member functions ------------------------------------------------
+
+Sketch::Sketch( const Genome* genome, const unsigned int scale )
+{
+  const size_t   blockSize = 1 << 20; // Number of residues decoded at a time
+  const uint64_t mask      = ( uint64_t( 1 ) << ( 2 * kmerLen ) ) - 1;
+  const uint64_t maxHash   = UINT64_MAX / std::max( scale, 1u );
+  const int      shift     = 2 * ( kmerLen - 1 );
+  std::string    block;
+
+  // The k-mer and its reverse complement are updated together, and the
+  // smaller of the two is hashed so both strands give the same hash
+  for ( unsigned int i = 0; i < genome->getNumContigs(); i++ )
+  {
+    size_t   len   = genome->getSeqLen( i );
+    uint64_t fwd   = 0;
+    uint64_t rev   = 0;
+    size_t   nBase = 0; // Number of consecutive bases
+    for ( size_t pos = 0; pos < len; pos += blockSize )
+    {
+      size_t n = std::min( blockSize, len - pos );
+      block.resize( n );
+      genome->decodeSeq( i, pos, n, &block[0] );
+      for ( const auto c : block )
+      {
+        uint64_t code;
+        switch ( c )
+        {
+          case 'A': case 'a': code = 0; break;
+          case 'C': case 'c': code = 1; break;
+          case 'G': case 'g': code = 2; break;
+          case 'T': case 't': code = 3; break;
+          default:
+            nBase = 0;
+            continue;
+        }
+        fwd = ( ( fwd << 2 ) | code ) & mask;
+        rev = ( rev >> 2 ) | ( ( 3 - code ) << shift );
+        if ( ++nBase < kmerLen ) continue;
+        uint64_t hash = hashKmer( std::min( fwd, rev ) );
+        if ( hash <= maxHash ) hashes.push_back( hash );
+      }
+    }
+  }
+  std::sort( hashes.begin(), hashes.end() );
+  hashes.erase( std::unique( hashes.begin(), hashes.end() ), hashes.end() );
+  hashes.shrink_to_fit();
+}
+
+size_t Sketch::size() const
+{
+  return hashes.size();
+}
+
+uint32_t Sketch::countShared( const Sketch &rhs ) const
+{
+  uint32_t nShared = 0;
+  auto     lIt     = hashes.begin();
+  auto     rIt     = rhs.hashes.begin();
+  while ( lIt != hashes.end() && rIt != rhs.hashes.end() )
+  {
+    if ( *lIt < *rIt ) lIt++;
+    else if ( *rIt < *lIt ) rIt++;
+    else
+    {
+      nShared++;
+      lIt++;
+      rIt++;
+    }
+  }
+  return nShared;
+}
+
+double Sketch::getAni( const double containment )
+{
+  // A k-mer is shared if none of its residues differ, so the containment
+  // is about the identity to the power of the k-mer length
+  if ( containment <= 0 ) return 0;
+  return std::pow( std::min( containment, 1.0 ), 1.0 / kmerLen );
+}
+
+unsigned int Sketch::getScale(
+  const unsigned int minLen, const double minIdent
+  )
+{
+  // Expect ten hashes from the k-mers of the region that are unchanged, so
+  // the chance that none are kept is about e^-10
+  const double nExpected = 10;
+  double ident = minIdent > 1 ? minIdent / 100 : minIdent;
+  if ( minLen < kmerLen ) return 1;
+  double nKmers = ( minLen - kmerLen + 1 ) * std::pow( ident, kmerLen );
+  return std::max( 1u, static_cast< unsigned int >( nKmers / nExpected ) );
+}
+
+uint64_t Sketch::hashKmer( uint64_t kmer )
+{
+  // Finalizer of MurmurHash3, which spreads the k-mers evenly over the
+  // range of the hash
+  kmer ^= kmer >> 33;
+  kmer *= 0xff51afd7ed558ccdULL;
+  kmer ^= kmer >> 33;
+  kmer *= 0xc4ceb9fe1a85ec53ULL;
+  kmer ^= kmer >> 33;
+  return kmer;
+}
+
+// -----------------------------------------------------------------------------
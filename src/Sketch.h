@@ -0,0 +1,68 @@
+#include "Genome.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+// -----------------------------------------------------------------------------
+// Sketch
+// Ryan D. Crawford
+// 2020/07/26
+// -----------------------------------------------------------------------------
+// This class is a FracMinHash sketch of a genome: the hashes of the
+// canonical k-mers of the genome that fall in the lowest 1/scale of the
+// range of the hash. Unlike a MinHash sketch of fixed size, the number of
+// hashes grows with the genome, so the fraction of the k-mers of one genome
+// found in another (the containment) can be estimated for genomes of any
+// size. The hashes shared by two genomes estimate the k-mers they share,
+// and the containment estimates their average nucleotide identity (ANI).
+// -----------------------------------------------------------------------------
+
+#ifndef _SKETCH_
+#define _SKETCH_
+class Sketch
+{
+public:
+
+  // Length of the k-mers
+  static constexpr unsigned int kmerLen = 21;
+
+  // Default Ctor
+  Sketch()
+  { ; }
+
+  // Value ctor: sketch the genome, keeping the hashes in the lowest
+  // 1/"scale" of the range
+  Sketch( const Genome* genome, const unsigned int scale );
+
+  // Dtor
+  ~Sketch()
+  { ; }
+
+  // Return the number of hashes in the sketch
+  size_t size() const;
+
+  // Return the number of hashes found in both sketches
+  uint32_t countShared( const Sketch &rhs ) const;
+
+  // Estimate the ANI of two genomes from the fraction of the k-mers of one
+  // that are found in the other
+  static double getAni( const double containment );
+
+  // Return the largest scale at which a region of "minLen" nts with an
+  // identity of "minIdent" is all but certain to share a hash with the
+  // genome it was aligned to. "minIdent" may be a fraction or a percent
+  static unsigned int getScale( const unsigned int minLen,
+    const double minIdent );
+
+private:
+
+  // Sorted hashes of the sketch
+  std::vector< uint64_t > hashes;
+
+  // Hash a two bit encoded k-mer
+  static uint64_t hashKmer( uint64_t kmer );
+};
+#endif
+
+// -----------------------------------------------------------------------------
@@ -30,7 +30,8 @@ bool operator>( const Subject & lhs, const Subject & rhs )
 void Subject::printSubj()
 {
   std::cout << "     -- "     << genome->getGenomeName() << ": "
-            << sSeqId << " (" << sStart << "-" << sEnd << ")"
+            << genome->getSeqIdName( sSeqId )
+            << " (" << sStart << "-" << sEnd << ")"
             << "; Query Position: " << qStart << "-" << qEnd
             << "; Lenght: "   << length << " nts"
             << "; Identity: " << pIdent << "%" << std::endl;
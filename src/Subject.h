@@ -15,7 +15,7 @@
 struct Subject
 {
   // Default Ctor
-  Subject( std::string sSeqId, int qStart, int qEnd, int sStart, int sEnd,
+  Subject( uint32_t sSeqId, int qStart, int qEnd, int sStart, int sEnd,
     int length, double pIdent, const Genome* genome ):
     sSeqId( sSeqId ), qStart( qStart ), qEnd( qEnd ), sStart( sStart ),
     sEnd( sEnd ), length( length ), pIdent( pIdent ), genome( genome )
@@ -24,7 +24,7 @@ struct Subject
   // Dtor
   ~Subject();
 
-  std::string   sSeqId; // Seq name of the query
+  uint32_t      sSeqId; // Contig id of the subject
   unsigned int  qStart; // Start of alignment in query
   unsigned int  qEnd;   // End of alignment in query
   unsigned int  sStart; // Start of alignment in subject
@@ -0,0 +1,80 @@
+#include "ThreadPool.h"
+
+// -----------------------------------------------------------------------------
+// ThreadPool
+// Ryan D. Crawford
+// 2020/06/09
+// -----------------------------------------------------------------------------
+
+// ---- ThreadPool member functions --------------------------------------------
+
+ThreadPool::ThreadPool( unsigned int nThreads ): nPending( 0 ), isDone( false )
+{
+  nThreads = resolveThreads( nThreads );
+  workers.reserve( nThreads );
+  for ( unsigned int i = 0; i < nThreads; i++ )
+    workers.push_back( std::thread( &ThreadPool::runJobs, this ) );
+}
+
+ThreadPool::~ThreadPool()
+{
+  wait();
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    isDone = true;
+  }
+  jobAdded.notify_all();
+  for ( auto &worker : workers ) worker.join();
+}
+
+void ThreadPool::addJob( std::function< void() > job )
+{
+  {
+    std::lock_guard< std::mutex > lock( mtx );
+    jobs.push_back( std::move( job ) );
+    nPending ++;
+  }
+  jobAdded.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock< std::mutex > lock( mtx );
+  jobDone.wait( lock, [this]() { return nPending == 0; } );
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+  return workers.size();
+}
+
+unsigned int ThreadPool::resolveThreads( unsigned int nThreads )
+{
+  if ( nThreads == 0 ) nThreads = std::thread::hardware_concurrency();
+  if ( nThreads == 0 ) nThreads = 1;
+  return nThreads;
+}
+
+void ThreadPool::runJobs()
+{
+  while ( true )
+  {
+    std::function< void() > job;
+    {
+      // Wait for a job to be added or for the pool to be destroyed
+      std::unique_lock< std::mutex > lock( mtx );
+      jobAdded.wait( lock, [this]() { return isDone || !jobs.empty(); } );
+      if ( jobs.empty() ) return;
+      job = std::move( jobs.front() );
+      jobs.pop_front();
+    }
+
+    job();
+
+    // Signal any waiting threads if this was the last job
+    std::lock_guard< std::mutex > lock( mtx );
+    if ( --nPending == 0 ) jobDone.notify_all();
+  }
+}
+
+// -----------------------------------------------------------------------------
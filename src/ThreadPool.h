@@ -0,0 +1,73 @@
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// -----------------------------------------------------------------------------
+// ThreadPool
+// Ryan D. Crawford
+// 2020/06/09
+// -----------------------------------------------------------------------------
+// This class runs jobs on a fixed number of worker threads. Jobs are started
+// in the order they are added. The pool can be waited on until every job
+// that has been added is finished, and may then be reused for the next set
+// of jobs. Jobs are responsible for synchronizing access to any shared data.
+// -----------------------------------------------------------------------------
+
+#ifndef _THREAD_POOL_
+#define _THREAD_POOL_
+class ThreadPool
+{
+public:
+
+  // Ctor: starts the input number of worker threads. If zero threads are
+  // requested one thread per core is started
+  ThreadPool( unsigned int nThreads );
+
+  // Dtor: waits for the remaining jobs and joins the worker threads
+  ~ThreadPool();
+
+  // Add a job to the end of the queue
+  void addJob( std::function< void() > job );
+
+  // Block until every job that has been added is finished
+  void wait();
+
+  // Return the number of worker threads
+  unsigned int getNumThreads() const;
+
+  // Return the number of threads to use for the input request, where zero
+  // requests one thread per core
+  static unsigned int resolveThreads( unsigned int nThreads );
+
+private:
+
+  // Function run by each worker thread
+  void runJobs();
+
+  // Worker threads
+  std::vector< std::thread > workers;
+
+  // Jobs that have not been started
+  std::deque< std::function< void() > > jobs;
+
+  // Number of jobs that have been added and are not finished
+  unsigned int nPending;
+
+  // True when the pool is being destroyed
+  bool isDone;
+
+  // Lock for the job queue and counters
+  std::mutex mtx;
+
+  // Signals the workers that a job was added
+  std::condition_variable jobAdded;
+
+  // Signals waiting threads that a job was finished
+  std::condition_variable jobDone;
+};
+#endif
+
+// -----------------------------------------------------------------------------
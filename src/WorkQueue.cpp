@@ -0,0 +1,339 @@
+#include "WorkQueue.h"
+namespace fs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+// WorkQueue
+// Ryan D. Crawford
+// 2020/07/28
+// -----------------------------------------------------------------------------
+
+// ---- WorkQueue member functions ---------------------------------------------
+
+WorkQueue::WorkQueue( const std::string &workDir ):
+  todoDir( workDir + "todo/" ), claimDir( workDir + "claimed/" ),
+  shardDir( workDir + "shards/" ), manifestPath( workDir + "manifest" )
+{
+  char host[256] = { 0 };
+  if ( gethostname( host, sizeof( host ) - 1 ) != 0 ) host[0] = '\0';
+  claimSuffix = "." + std::string( host ) + "." + std::to_string( getpid() );
+}
+
+bool WorkQueue::create(
+  const std::string &params, const std::vector< std::string > &jobs
+  )
+{
+  std::error_code ec;
+  for ( const auto &dir : { todoDir, claimDir, shardDir } )
+  {
+    fs::create_directories( dir, ec );
+    if ( !fs::is_directory( dir ) )
+    {
+      std::cout << "Unable to create the work directory " << dir << std::endl;
+      return false;
+    }
+  }
+
+  // The run is identified by its parameters and jobs. Workers wait while
+  // there is no manifest, so it is removed before the jobs are replaced
+  uint64_t key = hashString( params );
+  for ( const auto &job : jobs ) key = hashString( job, key );
+  std::string oldManifest;
+  uint64_t    oldKey    = 0;
+  bool        isResumed = readFile( manifestPath, oldManifest );
+  if ( isResumed )
+  {
+    const char* pos = oldManifest.data();
+    isResumed = getValue( pos, oldManifest.data() + oldManifest.size(),
+      oldKey ) && oldKey == key;
+  }
+  remove( manifestPath.c_str() );
+  clearDir( todoDir );
+  clearDir( claimDir );
+  if ( !isResumed ) clearDir( shardDir );
+
+  // Only the jobs without a shard are queued. Jobs that failed to be read
+  // are queued again
+  nJobs = jobs.size();
+  unsigned int nQueued = 0;
+  for ( unsigned int id = 0; id < nJobs; id++ )
+  {
+    std::string shard;
+    if ( isResumed && readShard( id, shard ) && !shard.empty() ) continue;
+    if ( !writeFile( todoDir + getJobName( id ), jobs[id] ) ) return false;
+    nQueued++;
+  }
+
+  std::string manifest;
+  putValue( manifest, key );
+  putString( manifest, params );
+  putValue( manifest, uint32_t( nJobs ) );
+  if ( !writeFile( manifestPath, manifest ) ) return false;
+  std::cout << "Queued " << nQueued << " of " << nJobs << " jobs in "
+            << todoDir << std::endl;
+  return true;
+}
+
+bool WorkQueue::open( const std::string &params )
+{
+  std::string manifest;
+  bool        isWaiting = false;
+  while ( !readFile( manifestPath, manifest ) )
+  {
+    if ( !isWaiting )
+      std::cout << "Waiting for the jobs of the coordinator in "
+                << manifestPath << std::endl;
+    isWaiting = true;
+    std::this_thread::sleep_for( std::chrono::seconds( pollSecs ) );
+  }
+
+  const char* pos = manifest.data();
+  const char* end = manifest.data() + manifest.size();
+  uint64_t    key;
+  std::string runParams;
+  uint32_t    n;
+  if ( !getValue( pos, end, key ) || !getString( pos, end, runParams ) ||
+    !getValue( pos, end, n ) )
+  {
+    return false;
+  }
+  if ( runParams != params )
+  {
+    std::cout << "The settings of the coordinator \"" << runParams
+              << "\" do not match the settings of the worker \"" << params
+              << "\"" << std::endl;
+    return false;
+  }
+  nJobs = n;
+  return true;
+}
+
+unsigned int WorkQueue::getNumJobs() const
+{
+  return nJobs;
+}
+
+bool WorkQueue::isComplete() const
+{
+  for ( unsigned int id = 0; id < nJobs; id++ )
+    if ( !fs::exists( getShardPath( id ) ) ) return false;
+  return true;
+}
+
+bool WorkQueue::claimJob( unsigned int &jobId, std::string &job )
+{
+  std::lock_guard< std::mutex > lock( queueMutex );
+  for ( bool isListed = false; ; )
+  {
+    // The queue is listed again once the jobs of the last listing are
+    // claimed, by this or another process
+    if ( candidates.empty() )
+    {
+      if ( isListed ) return false;
+      std::vector< std::string > names;
+      std::error_code ec;
+      for ( const auto &entry : fs::directory_iterator( todoDir, ec ) )
+      {
+        std::string name = entry.path().filename().string();
+        if ( name.size() > 4 &&
+          name.compare( name.size() - 4, 4, ".job" ) == 0 )
+        {
+          names.push_back( name );
+        }
+      }
+      std::sort( names.begin(), names.end() );
+      candidates.assign( names.begin(), names.end() );
+      isListed = true;
+      continue;
+    }
+    std::string name = candidates.front();
+    candidates.pop_front();
+
+    // Only one process can move the job out of the queue
+    std::string claimPath = claimDir + name + claimSuffix;
+    if ( rename( ( todoDir + name ).c_str(), claimPath.c_str() ) != 0 )
+      continue;
+
+    // Files that are not jobs of this run are removed. A job that can not
+    // be read is finished with an empty shard, which marks it as failed, so
+    // that the run does not wait for it
+    if ( !getJobId( name, jobId ) || jobId >= nJobs )
+    {
+      std::cout << "Warning: removing " << claimPath << ", which is not "
+                << "one of the queued jobs" << std::endl;
+      remove( claimPath.c_str() );
+      continue;
+    }
+    if ( !readFile( claimPath, job ) )
+    {
+      std::cout << "Warning: the job " << claimPath << " is corrupt"
+                << std::endl;
+      if ( !writeFile( getShardPath( jobId ), "" ) )
+      {
+        std::cout << "Unable to write the shard of job " << jobId
+                  << std::endl;
+        exit( 1 );
+      }
+      remove( claimPath.c_str() );
+      continue;
+    }
+    ownClaims.insert( claimPath );
+    return true;
+  }
+}
+
+bool WorkQueue::writeShard( const unsigned int jobId, const std::string &shard )
+{
+  bool isWritten = writeFile( getShardPath( jobId ), shard );
+  std::string claimPath = claimDir + getJobName( jobId ) + claimSuffix;
+  remove( claimPath.c_str() );
+  std::lock_guard< std::mutex > lock( queueMutex );
+  ownClaims.erase( claimPath );
+  return isWritten;
+}
+
+bool WorkQueue::readShard( const unsigned int jobId, std::string &shard ) const
+{
+  return readFile( getShardPath( jobId ), shard );
+}
+
+void WorkQueue::touchClaims()
+{
+  std::lock_guard< std::mutex > lock( queueMutex );
+  for ( const auto &claimPath : ownClaims ) utime( claimPath.c_str(), nullptr );
+}
+
+unsigned int WorkQueue::requeueStale()
+{
+  // The times are compared to the clock of this process, as the clocks of
+  // the nodes may differ
+  auto now = std::chrono::steady_clock::now();
+  std::set< std::string > seen;
+  unsigned int nRequeued = 0;
+  std::error_code ec;
+  std::vector< fs::path > claims;
+  for ( const auto &entry : fs::directory_iterator( claimDir, ec ) )
+    claims.push_back( entry.path() );
+  for ( const auto &path : claims )
+  {
+    std::string claimPath = path.string();
+    {
+      std::lock_guard< std::mutex > lock( queueMutex );
+      if ( ownClaims.count( claimPath ) ) continue;
+    }
+    struct stat sb;
+    if ( stat( claimPath.c_str(), &sb ) != 0 ) continue;
+    seen.insert( claimPath );
+    auto it = claimTimes.find( claimPath );
+    if ( it == claimTimes.end() || it->second.first != sb.st_mtime )
+    {
+      claimTimes[ claimPath ] = { sb.st_mtime, now };
+      continue;
+    }
+    if ( now - it->second.second < std::chrono::seconds( staleSecs ) )
+      continue;
+
+    // The claim is named after the job, followed by the host and process.
+    // A worker that stopped after writing the shard leaves its claim behind
+    std::string  name    = path.filename().string();
+    std::string  jobName = name.substr( 0, name.find( ".job" ) + 4 );
+    unsigned int jobId;
+    if ( !getJobId( jobName, jobId ) || jobId >= nJobs ||
+      fs::exists( getShardPath( jobId ) ) )
+    {
+      remove( claimPath.c_str() );
+      continue;
+    }
+    if ( rename( claimPath.c_str(), ( todoDir + jobName ).c_str() ) == 0 )
+    {
+      std::cout << "Returning the stale claim " << name << " to the queue"
+                << std::endl;
+      nRequeued++;
+    }
+  }
+  for ( auto it = claimTimes.begin(); it != claimTimes.end(); )
+  {
+    if ( seen.count( it->first ) ) it++;
+    else it = claimTimes.erase( it );
+  }
+  return nRequeued;
+}
+
+std::string WorkQueue::getJobName( const unsigned int jobId )
+{
+  // Jobs are padded to the same length so they sort in the order queued
+  std::string id = std::to_string( jobId );
+  return std::string( id.size() < 8 ? 8 - id.size() : 0, '0' ) + id + ".job";
+}
+
+bool WorkQueue::getJobId( const std::string &jobName, unsigned int &jobId )
+{
+  if ( jobName.size() != 12 || jobName.compare( 8, 4, ".job" ) != 0 )
+    return false;
+  for ( unsigned int i = 0; i < 8; i++ )
+    if ( !isdigit( jobName[i] ) ) return false;
+  jobId = std::stoul( jobName.substr( 0, 8 ) );
+  return true;
+}
+
+std::string WorkQueue::getShardPath( const unsigned int jobId ) const
+{
+  std::string name = getJobName( jobId );
+  return shardDir + name.substr( 0, name.size() - 4 ) + ".pws";
+}
+
+bool WorkQueue::writeFile(
+  const std::string &path, const std::string &payload
+  ) const
+{
+  std::string header;
+  header.append( fileMagic, 8 );
+  putValue( header, hashBytes( payload.data(), payload.size() ) );
+
+  // The temporary file is named after the process, so that processes on
+  // different hosts never write to the same file
+  std::string tmpPath = path + ".tmp" + claimSuffix;
+  std::ofstream ofs( tmpPath.c_str(), std::ios::binary );
+  if ( ofs.fail() || !ofs.is_open() ) return false;
+  ofs.write( header.data(), header.size() );
+  ofs.write( payload.data(), payload.size() );
+  ofs.close();
+  if ( ofs.fail() || rename( tmpPath.c_str(), path.c_str() ) != 0 )
+  {
+    remove( tmpPath.c_str() );
+    return false;
+  }
+  return true;
+}
+
+bool WorkQueue::readFile( const std::string &path, std::string &payload )
+{
+  std::ifstream ifs( path.c_str(), std::ios::binary );
+  if ( !ifs.is_open() ) return false;
+  std::string buf( ( std::istreambuf_iterator< char >( ifs ) ),
+    std::istreambuf_iterator< char >() );
+
+  const char* pos = buf.data();
+  const char* end = buf.data() + buf.size();
+  char        magic[8];
+  uint64_t    payloadHash;
+  if ( !getValue( pos, end, magic ) || memcmp( magic, fileMagic, 8 ) != 0 )
+    return false;
+  if ( !getValue( pos, end, payloadHash ) ||
+    hashBytes( pos, end - pos ) != payloadHash )
+  {
+    return false;
+  }
+  payload.assign( pos, end );
+  return true;
+}
+
+void WorkQueue::clearDir( const std::string &dirPath )
+{
+  std::error_code ec;
+  std::vector< fs::path > paths;
+  for ( const auto &entry : fs::directory_iterator( dirPath, ec ) )
+    paths.push_back( entry.path() );
+  for ( const auto &path : paths ) fs::remove( path, ec );
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,151 @@
+#include "Hash.h"
+#include "BinaryIO.h"
+#include <vector>
+#include <string>
+#include <deque>
+#include <set>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+
+// -----------------------------------------------------------------------------
+// WorkQueue
+// Ryan D. Crawford
+// 2020/07/28
+// -----------------------------------------------------------------------------
+// This class is a queue of jobs in a directory on a shared filesystem, so
+// that the searches of a run can be spread over processes on any number of
+// nodes without a scheduler. The coordinator writes each job to its own
+// file in "todo/", then writes the manifest, which workers wait for. A job
+// is claimed by renaming its file into "claimed/", which only one process
+// can do, and finished by writing its result shard to "shards/". Every file
+// is written to a temporary file first and renamed, and is checked against
+// a hash of its contents when it is read. Workers touch the files of their
+// claims while the jobs run; the coordinator returns claims that are not
+// touched for "staleSecs" to "todo/", so the jobs of a worker that died are
+// run again. Shards are kept if a run with the same jobs is started again,
+// so an interrupted run only runs the jobs that were not finished.
+// -----------------------------------------------------------------------------
+
+#ifndef _WORK_QUEUE_
+#define _WORK_QUEUE_
+class WorkQueue
+{
+public:
+
+  // Seconds between the checks of a waiting process, and between touches
+  // of the claims of a worker
+  static constexpr unsigned int pollSecs  = 2;
+  static constexpr unsigned int touchSecs = 10;
+
+  // Seconds a claim may go untouched before it is returned to the queue
+  static constexpr unsigned int staleSecs = 300;
+
+  // Ctor: takes the shared work directory
+  WorkQueue( const std::string &workDir );
+
+  // Dtor
+  ~WorkQueue()
+  { ; }
+
+  // Queue the jobs as the coordinator. "params" describes the settings the
+  // workers must share with the coordinator. If the directory holds the
+  // shards of a run with the same parameters and jobs, those jobs are not
+  // queued again. Returns false if the jobs could not be written
+  bool create( const std::string &params,
+    const std::vector< std::string > &jobs );
+
+  // Wait for the manifest of the coordinator as a worker. Returns false if
+  // the parameters of the coordinator are not "params"
+  bool open( const std::string &params );
+
+  // Return the number of jobs in the queue
+  unsigned int getNumJobs() const;
+
+  // Returns true once every job has a shard
+  bool isComplete() const;
+
+  // Claim the next job in the queue. Jobs that are corrupt are given an
+  // empty shard rather than claimed. Returns false if no job is left to
+  // claim
+  bool claimJob( unsigned int &jobId, std::string &job );
+
+  // Write the shard of a claimed job and release the claim. Returns false
+  // if the shard could not be written
+  bool writeShard( const unsigned int jobId, const std::string &shard );
+
+  // Read the shard of a job. Returns false if it is missing or corrupt
+  bool readShard( const unsigned int jobId, std::string &shard ) const;
+
+  // Update the modification times of the claims of this process
+  void touchClaims();
+
+  // Return the claims of other processes that have not been touched for
+  // "staleSecs" to the queue. Returns the number of jobs returned
+  unsigned int requeueStale();
+
+private:
+
+  // Directories of the queued jobs, the claimed jobs and the shards, and
+  // the path of the manifest
+  std::string todoDir;
+  std::string claimDir;
+  std::string shardDir;
+  std::string manifestPath;
+
+  // Number of jobs in the queue
+  unsigned int nJobs = 0;
+
+  // Added to the names of the claims of this process: the name of the
+  // host and the id of the process
+  std::string claimSuffix;
+
+  // Jobs that were queued the last time "todoDir" was listed
+  std::deque< std::string > candidates;
+
+  // Claims held by this process, by the path of their file
+  std::set< std::string > ownClaims;
+
+  // Last modification time seen for each claim of another process, and
+  // when it was first seen
+  std::map< std::string, std::pair< time_t,
+    std::chrono::steady_clock::time_point > > claimTimes;
+
+  // Protects "candidates" and "ownClaims"
+  std::mutex queueMutex;
+
+  // Identify the format of the manifest, jobs and shards
+  static constexpr char fileMagic[9] = "PEARLWQ1";
+
+  // Return the name of the file of a job and the path to its shard
+  static std::string getJobName( const unsigned int jobId );
+
+  // Read the id of a job from the name of its file. Returns false if the
+  // name is not the name of a job
+  static bool getJobId( const std::string &jobName, unsigned int &jobId );
+  std::string getShardPath( const unsigned int jobId ) const;
+
+  // Write the contents to a temporary file with a header, then rename it
+  // to "path". Returns false if the file could not be written
+  bool writeFile( const std::string &path, const std::string &payload ) const;
+
+  // Read a file written by "writeFile". Returns false if it is missing or
+  // corrupt
+  static bool readFile( const std::string &path, std::string &payload );
+
+  // Remove the files in a directory
+  static void clearDir( const std::string &dirPath );
+};
+#endif
+
+// -----------------------------------------------------------------------------
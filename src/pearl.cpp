@@ -1,6 +1,7 @@
 #include "BlastData.h"
 #include "InputParser.h"
 #include "GenomeData.h"
+#include <csignal>
 
 // -----------------------------------------------------------------------------
 // Pearl
@@ -21,22 +22,90 @@
 
 int main( int argc, char *argv[] )
 {
+  // The aligners are fed their input through pipes. An aligner that exits
+  // before reading all of it makes the write fail with EPIPE, which is
+  // reported as a failed search, rather than killing pearl with SIGPIPE
+  signal( SIGPIPE, SIG_IGN );
+
   // Parse the command line arguments and print the inputs
   InputParser inputs( argc, argv );
   inputs.printArgs();
 
-  // Parse the fasta files for the input genomes
-  GenomeData genomes( inputs.fastaFiles, inputs.genomeIds );
+  // Initialize the input genomes. The fasta files are not opened yet
+  GenomeData genomes( inputs.fastaFiles, inputs.genomeIds,
+    inputs.genomeSizes, inputs.genomeContigs );
+
+  // Genomes that do not fit in the memory budget are read from disk
+  genomes.setMemBudget( inputs.maxMem, inputs.outDir + "pearl_spill/" );
+
+  // If the sizes of the genomes were not all given in the manifest, the
+  // fasta files are parsed to get them before sorting. The contigs are only
+  // hashed if duplicates are to be found
+  bool isHashed = inputs.isDeduped && !inputs.isWorker;
+  if ( !genomes.hasGenomeStats() )
+  {
+    genomes.loadGenomes( inputs.lazyLoad, inputs.nThreads, inputs.cacheDir,
+      isHashed );
+  }
 
   // Sort the genomes by the number of contigs and size
   genomes.sortGenomes();
 
+  // Parse the remaining fasta files, in the sorted order
+  genomes.loadGenomes( inputs.lazyLoad, inputs.nThreads, inputs.cacheDir,
+    isHashed );
+
+  // Mask the genomes, so that regions that can not hold an alignment are
+  // not searched and low complexity regions do not seed alignments
+  if ( inputs.isMasked ) genomes.maskGenomes( inputs.minLen, inputs.nThreads );
+
+  // Sketch the genomes, so that pairs that can not share an alignment are
+  // not searched and related genomes are compared first
+  if ( inputs.isSketched && !inputs.isWorker )
+  {
+    unsigned int scale = inputs.sketchScale > 0 ? inputs.sketchScale :
+      Sketch::getScale( inputs.minLen, inputs.minIdent );
+    genomes.sketchGenomes( scale, inputs.nThreads );
+    genomes.sortBySimilarity();
+    genomes.writeSketchStats( inputs.outPath + "sketch.tsv" );
+  }
+
+  // Create the aligner used to compare the genomes
+  auto aligner = Aligner::create( inputs.aligner, inputs.pafCmd,
+    inputs.minLen );
+  if ( aligner == nullptr )
+  {
+    std::cout << "Unknown aligner: " << inputs.aligner << std::endl;
+    exit( 1 );
+  }
+  aligner->setMemBudget( inputs.maxMem );
+
+  // A worker only runs the searches queued by the coordinator
+  if ( inputs.isWorker )
+  {
+    BlastData worker( genomes, inputs.workDir, inputs.minLen,
+      inputs.nThreads, inputs.isBatched, *aligner );
+    return 0;
+  }
+
+  // Genomes that are exact duplicates of another genome are not searched.
+  // Their hits are copied from the genome they duplicate
+  if ( inputs.isDeduped )
+  {
+    genomes.findDuplicates();
+    genomes.writeDuplicates( inputs.outPath + "duplicates.tsv" );
+  }
+
   // Blast the fasta files against each other
-  BlastData blastData( genomes, inputs.outDir, inputs.minIdent, inputs.minLen );
+  BlastData blastData( genomes, inputs.outDir, inputs.minIdent, inputs.minLen,
+    inputs.nThreads, inputs.keepTsv, inputs.isBatched, inputs.isGreedy,
+    inputs.chunkSize, inputs.chunkOverlap, inputs.blastCacheDir,
+    inputs.workDir, *aligner );
 
   // Blast the genomes and find the alignments that are high identity
   // between sets of genomes
-  blastData.findUniqueAligns( inputs.outPath );
+  blastData.findUniqueAligns( inputs.outPath, inputs.lineWidth,
+    inputs.mergeGroups );
 
   return 0;
 }
@@ -0,0 +1,77 @@
+#!/bin/bash
+# -----------------------------------------------------------------------------
+# fixtures.sh
+# Ryan D. Crawford
+# 2020/07/28
+# -----------------------------------------------------------------------------
+# Functions sourced by the tests to generate small genomes and to compare the
+# outputs of runs. The genomes are generated from fixed seeds, so every run of
+# a test searches the same sequences.
+# -----------------------------------------------------------------------------
+
+# Write a random sequence of "len" bases from the seed, 80 bases per line
+randomSeq()
+{
+  awk -v seed="$1" -v len="$2" 'BEGIN {
+    srand( seed );
+    split( "A C G T", bases, " " );
+    for ( i = 1; i <= len; i++ )
+    {
+      printf "%s", bases[ int( rand() * 4 ) + 1 ];
+      if ( i % 80 == 0 || i == len ) printf "\n";
+    }
+  }'
+}
+
+# Write "nGenomes" genomes to "dir" that share a backbone of "len" bases,
+# each with an insertion of "insLen" bases of its own in the middle
+makeFamily()
+{
+  local dir=$1 nGenomes=$2 len=$3 insLen=$4
+  mkdir -p "$dir"
+  randomSeq 1 "$len" | tr -d '\n' > "$dir/backbone.txt"
+  for (( g = 1; g <= nGenomes; g++ ))
+  do
+    {
+      echo ">contig_1"
+      {
+        head -c $(( len / 2 )) "$dir/backbone.txt"
+        randomSeq $(( 100 + g )) "$insLen" | tr -d '\n'
+        tail -c +$(( len / 2 + 1 )) "$dir/backbone.txt"
+      } | fold -w 80
+      echo
+    } > "$dir/genome_$g.fasta"
+  done
+  rm "$dir/backbone.txt"
+}
+
+# Write two genomes of "len" bases to "dir" that differ by a single
+# substitution in the middle
+makeSnpPair()
+{
+  local dir=$1 len=$2
+  mkdir -p "$dir"
+  randomSeq 7 "$len" | tr -d '\n' > "$dir/seq.txt"
+  local mid=$(( len / 2 + 1 ))
+  local base=$( cut -c "$mid" "$dir/seq.txt" )
+  local snp=A
+  [ "$base" = "A" ] && snp=C
+  { echo ">contig_1"; fold -w 80 "$dir/seq.txt"; echo; } > "$dir/g1.fasta"
+  {
+    echo ">contig_1"
+    {
+      head -c $(( mid - 1 )) "$dir/seq.txt"
+      echo -n "$snp"
+      tail -c +$(( mid + 1 )) "$dir/seq.txt"
+    } | fold -w 80
+    echo
+  } > "$dir/g2.fasta"
+  rm "$dir/seq.txt"
+}
+
+# Print the sequences written by a run, sorted so that runs can be compared
+# whatever order the sequences were written in
+sortedSeqs()
+{
+  paste - - < "$1/pearl_seqs.fasta" | sort
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# -----------------------------------------------------------------------------
+# merge.sh
+# Ryan D. Crawford
+# 2020/07/28
+# -----------------------------------------------------------------------------
+# Check that merging the unique alignments of groups of genomes in a tree
+# writes the same sequences as merging the genomes one at a time.
+#
+# Usage: merge.sh [path to pearl] [number of threads]
+# -----------------------------------------------------------------------------
+
+source "$( dirname "${BASH_SOURCE[0]}" )/fixtures.sh"
+checkAligners
+makeFamily "$tmpDir/family" 8 30000 3000
+
+for aligner in $aligners
+do
+  runPearl "family_$aligner" family --aligner "$aligner" \
+    --threads "$nThreads"
+  for nGroups in 2 3 8
+  do
+    runPearl "family_${aligner}_g$nGroups" family --aligner "$aligner" \
+      --threads "$nThreads" --mergeGroups "$nGroups"
+    compareRuns "family_${aligner}_g$nGroups" "family_$aligner"
+  done
+done
+finish merge
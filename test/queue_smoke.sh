@@ -0,0 +1,48 @@
+#!/bin/bash
+# -----------------------------------------------------------------------------
+# queue_smoke.sh
+# Ryan D. Crawford
+# 2020/07/28
+# -----------------------------------------------------------------------------
+# Run the searches of a small set of genomes through a work directory, with a
+# coordinator and two workers on this machine, and check that the sequences
+# written are the same as those of a single process.
+#
+# Usage: queue_smoke.sh [path to pearl] [aligner]
+# -----------------------------------------------------------------------------
+
+testDir=$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )
+pearl=$( realpath "${1:-$testDir/../src/pearl}" )
+aligner=${2:-internal}
+tmpDir=$( mktemp -d )
+trap 'kill $( jobs -p ) 2> /dev/null; rm -rf "$tmpDir"' EXIT
+
+# Four genomes that share a backbone, each with its own insertion
+source "$testDir/fixtures.sh"
+makeFamily "$tmpDir/genomes" 4 60000 5000
+
+runPearl()
+{
+  local outDir=$1
+  shift
+  mkdir -p "$outDir"
+  "$pearl" --fastaDir "$tmpDir/genomes" --outDir "$outDir" --cacheDir none \
+    --blastCache none --aligner "$aligner" --threads 2 "$@" < /dev/null \
+    > "$outDir.log" 2>&1
+}
+
+runPearl "$tmpDir/single" || { echo "FAIL: single process run"; exit 1; }
+
+# The workers wait for the manifest of the coordinator
+runPearl "$tmpDir/worker1" --workDir "$tmpDir/work" --worker &
+runPearl "$tmpDir/worker2" --workDir "$tmpDir/work" --worker &
+runPearl "$tmpDir/queued" --workDir "$tmpDir/work" ||
+  { echo "FAIL: coordinator run"; exit 1; }
+wait
+
+if [ "$( sortedSeqs "$tmpDir/single" )" != "$( sortedSeqs "$tmpDir/queued" )" ]
+then
+  echo "FAIL: the queued run differs from the single process run"
+  exit 1
+fi
+echo "PASS: queue_smoke ($aligner)"